@@ -75,9 +75,6 @@ if ! command -v R &> /dev/null; then
     echo "WARNING: R not found. The application will not work without R installed."
 fi
 
-echo "Installing jsonlite..."
-R -e "if (!require('jsonlite', quietly=TRUE)) install.packages('jsonlite', repos='https://cloud.r-project.org')"
-
 echo "Installing qide R package..."
 R CMD INSTALL qiderpkg
 
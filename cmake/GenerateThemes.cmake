@@ -0,0 +1,86 @@
+# Converts the bundled Gogh JSON themes into a C++ table that is compiled
+# into q, so bundled themes need no file I/O or JSON parsing at runtime.
+#
+# Usage: cmake -DTHEMES_DIR=<dir> -DOUTPUT=<file.cpp> -P GenerateThemes.cmake
+#
+# Gogh files are flat objects of string values, so a regex per key is
+# enough here and keeps the script working on CMake versions without
+# string(JSON).
+
+if(NOT THEMES_DIR OR NOT OUTPUT)
+    message(FATAL_ERROR "GenerateThemes.cmake needs THEMES_DIR and OUTPUT")
+endif()
+
+set(THEME_COLOR_KEYS
+    background foreground cursor
+    color_01 color_02 color_03 color_04 color_05 color_06 color_07 color_08
+    color_09 color_10 color_11 color_12 color_13 color_14 color_15 color_16
+)
+
+# Reads the string value of KEY from CONTENT. JSON escapes (\", \\, \uXXXX)
+# are valid C++ escapes as well, so the raw text is copied verbatim.
+function(theme_value CONTENT KEY OUT)
+    if(CONTENT MATCHES "\"${KEY}\"[ \t\r\n]*:[ \t\r\n]*\"(([^\"\\\\]|\\\\.)*)\"")
+        set(${OUT} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+    else()
+        set(${OUT} "" PARENT_SCOPE)
+    endif()
+endfunction()
+
+file(GLOB THEME_FILES "${THEMES_DIR}/*.json")
+list(SORT THEME_FILES)
+
+set(ENTRIES "")
+set(COUNT 0)
+foreach(THEME_FILE ${THEME_FILES})
+    file(READ "${THEME_FILE}" CONTENT)
+    get_filename_component(FILE_NAME "${THEME_FILE}" NAME)
+
+    theme_value("${CONTENT}" name NAME)
+    if(NAME STREQUAL "")
+        message(WARNING "Skipping theme without a name: ${FILE_NAME}")
+        continue()
+    endif()
+    theme_value("${CONTENT}" author AUTHOR)
+    theme_value("${CONTENT}" variant VARIANT)
+
+    set(COLORS "")
+    foreach(KEY ${THEME_COLOR_KEYS})
+        theme_value("${CONTENT}" ${KEY} VALUE)
+        # Missing or malformed colors become -1 and fall back to the same
+        # defaults the JSON loader uses
+        if(VALUE MATCHES "^#([0-9A-Fa-f][0-9A-Fa-f][0-9A-Fa-f][0-9A-Fa-f][0-9A-Fa-f][0-9A-Fa-f])$")
+            list(APPEND COLORS "0x${CMAKE_MATCH_1}")
+        else()
+            if(NOT VALUE STREQUAL "")
+                message(WARNING "${FILE_NAME}: unsupported color '${VALUE}' for ${KEY}")
+            endif()
+            list(APPEND COLORS "-1")
+        endif()
+    endforeach()
+    string(REPLACE ";" ", " COLORS "${COLORS}")
+
+    string(APPEND ENTRIES "    { u8\"${NAME}\", u8\"${AUTHOR}\", u8\"${VARIANT}\",\n      { ${COLORS} } },\n")
+    math(EXPR COUNT "${COUNT} + 1")
+endforeach()
+
+set(SOURCE "// Generated by cmake/GenerateThemes.cmake from gogh-themes/*.json.
+// Do not edit; changes are overwritten on the next build.
+
+#include \"bundledthemes.h\"
+
+constexpr BundledTheme bundledThemes[] = {
+${ENTRIES}};
+
+constexpr int bundledThemeCount = ${COUNT};
+")
+
+# Only touch the output when it changes so unrelated builds don't recompile it
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" OLD_SOURCE)
+else()
+    set(OLD_SOURCE "")
+endif()
+if(NOT SOURCE STREQUAL OLD_SOURCE)
+    file(WRITE "${OUTPUT}" "${SOURCE}")
+endif()
@@ -0,0 +1,192 @@
+// Writes a page of data viewer columns into a POSIX shared-memory
+// segment that Q maps directly, instead of formatting every cell as text
+// and pushing it through the socket. Numbers stay binary; Q formats only
+// the cells it paints. Layout, in native byte order (both processes run
+// on the same machine), with every section 8-byte aligned:
+//
+//   header:      u32 magic 'QCOL', u32 version, u32 rows, u32 columns
+//   descriptors: per column u32 type, u32 reserved, u64 data offset,
+//                u64 validity offset, u64 string offsets offset
+//   sections:    validity bitmap (bit set = not NA), then the values:
+//                f64 or i32 per row, or for strings (rows + 1) u64
+//                offsets into the UTF-8 bytes that follow
+//
+// The layout is mirrored by SharedColumns in Q.
+
+#include <R.h>
+#include <Rinternals.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define QCOL_MAGIC 0x4c4f4351u  // "QCOL"
+#define QCOL_VERSION 1u
+
+enum { COL_DOUBLE = 1, COL_INTEGER = 2, COL_LOGICAL = 3, COL_STRING = 4 };
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t data;
+    uint64_t validity;
+    uint64_t offsets;
+} descriptor;
+
+static uint64_t align8(uint64_t n)
+{
+    return (n + 7u) & ~(uint64_t) 7u;
+}
+
+// Returns the size of the new segment, or -1 if it could not be created.
+// Q unlinks the segment once it has mapped it.
+SEXP qide_shm_write(SEXP name, SEXP columns, SEXP nrows)
+{
+#ifdef _WIN32
+    return ScalarReal(-1);
+#else
+    if (!isString(name) || LENGTH(name) != 1 || TYPEOF(columns) != VECSXP) {
+        error("expected a segment name and a list of columns");
+    }
+    const R_xlen_t rows = (R_xlen_t) asReal(nrows);
+    const int ncol = LENGTH(columns);
+    const uint64_t validityBytes = align8(((uint64_t) rows + 7u) / 8u);
+
+    // First pass: types and sizes. String bytes are looked up once and
+    // kept for the second pass.
+    uint64_t size = align8(16 + (uint64_t) ncol * sizeof(descriptor));
+    const char ***strings = (const char ***) R_alloc(ncol > 0 ? ncol : 1, sizeof(char **));
+    uint32_t *types = (uint32_t *) R_alloc(ncol > 0 ? ncol : 1, sizeof(uint32_t));
+    for (int j = 0; j < ncol; ++j) {
+        SEXP col = VECTOR_ELT(columns, j);
+        if (XLENGTH(col) != rows) {
+            error("column %d has the wrong length", j + 1);
+        }
+        strings[j] = NULL;
+        size += validityBytes;
+        switch (TYPEOF(col)) {
+        case REALSXP:
+            types[j] = COL_DOUBLE;
+            size += align8((uint64_t) rows * 8u);
+            break;
+        case INTSXP:
+            types[j] = COL_INTEGER;
+            size += align8((uint64_t) rows * 4u);
+            break;
+        case LGLSXP:
+            types[j] = COL_LOGICAL;
+            size += align8((uint64_t) rows * 4u);
+            break;
+        case STRSXP: {
+            types[j] = COL_STRING;
+            strings[j] = (const char **) R_alloc(rows > 0 ? rows : 1, sizeof(char *));
+            uint64_t bytes = 0;
+            for (R_xlen_t i = 0; i < rows; ++i) {
+                SEXP s = STRING_ELT(col, i);
+                strings[j][i] = s == NA_STRING ? "" : translateCharUTF8(s);
+                bytes += strlen(strings[j][i]);
+            }
+            size += align8(((uint64_t) rows + 1u) * 8u) + align8(bytes);
+            break;
+        }
+        default:
+            error("column %d has an unsupported type", j + 1);
+        }
+    }
+
+    const char *path = CHAR(STRING_ELT(name, 0));
+    int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return ScalarReal(-1);
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+        close(fd);
+        shm_unlink(path);
+        return ScalarReal(-1);
+    }
+    unsigned char *base = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(path);
+        return ScalarReal(-1);
+    }
+
+    uint32_t header[4] = { QCOL_MAGIC, QCOL_VERSION, (uint32_t) rows, (uint32_t) ncol };
+    memcpy(base, header, sizeof(header));
+    descriptor *descriptors = (descriptor *) (base + 16);
+    uint64_t offset = align8(16 + (uint64_t) ncol * sizeof(descriptor));
+
+    // Second pass: fill the sections. ftruncate() zeroed the segment, so
+    // only valid rows need their validity bit set.
+    for (int j = 0; j < ncol; ++j) {
+        SEXP col = VECTOR_ELT(columns, j);
+        descriptor *d = &descriptors[j];
+        memset(d, 0, sizeof(*d));
+        d->type = types[j];
+        d->validity = offset;
+        unsigned char *validity = base + offset;
+        offset += validityBytes;
+        d->data = offset;
+
+        switch (types[j]) {
+        case COL_DOUBLE: {
+            const double *x = REAL(col);
+            memcpy(base + offset, x, (size_t) rows * 8u);
+            for (R_xlen_t i = 0; i < rows; ++i) {
+                if (!ISNA(x[i])) validity[i >> 3] |= (unsigned char) (1u << (i & 7));
+            }
+            offset += align8((uint64_t) rows * 8u);
+            break;
+        }
+        case COL_INTEGER:
+        case COL_LOGICAL: {
+            const int *x = types[j] == COL_INTEGER ? INTEGER(col) : LOGICAL(col);
+            memcpy(base + offset, x, (size_t) rows * 4u);
+            for (R_xlen_t i = 0; i < rows; ++i) {
+                if (x[i] != NA_INTEGER) validity[i >> 3] |= (unsigned char) (1u << (i & 7));
+            }
+            offset += align8((uint64_t) rows * 4u);
+            break;
+        }
+        case COL_STRING: {
+            uint64_t *offsets = (uint64_t *) (base + offset);
+            d->offsets = offset;
+            offset += align8(((uint64_t) rows + 1u) * 8u);
+            d->data = offset;
+            uint64_t pos = 0;
+            for (R_xlen_t i = 0; i < rows; ++i) {
+                const size_t n = strlen(strings[j][i]);
+                offsets[i] = pos;
+                memcpy(base + offset + pos, strings[j][i], n);
+                pos += n;
+                if (STRING_ELT(col, i) != NA_STRING) validity[i >> 3] |= (unsigned char) (1u << (i & 7));
+            }
+            offsets[rows] = pos;
+            offset += align8(pos);
+            break;
+        }
+        }
+    }
+
+    munmap(base, (size_t) size);
+    return ScalarReal((double) size);
+#endif
+}
+
+// Removes a segment Q never picked up
+SEXP qide_shm_unlink(SEXP name)
+{
+#ifndef _WIN32
+    if (isString(name)) {
+        for (int i = 0; i < LENGTH(name); ++i) {
+            shm_unlink(CHAR(STRING_ELT(name, i)));
+        }
+    }
+#endif
+    return R_NilValue;
+}
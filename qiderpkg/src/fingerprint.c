@@ -0,0 +1,80 @@
+// Cheap change detection for the environment monitor. Instead of
+// recomputing object.size() for every object after every command, qide
+// compares a fingerprint built from object identity: R allocates a new
+// object on almost every modification, and the in-place cases (a list
+// element or an attribute replaced) are caught by also mixing in the
+// addresses of list elements and of the dim and class attributes.
+
+#include <R.h>
+#include <Rinternals.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static uint64_t mix(uint64_t hash, uint64_t value)
+{
+    // FNV-1a over the 8 bytes of value
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t fingerprint(SEXP x)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = mix(hash, (uint64_t) (uintptr_t) x);
+    hash = mix(hash, (uint64_t) TYPEOF(x));
+
+    if (isVector(x)) {
+        hash = mix(hash, (uint64_t) XLENGTH(x));
+        hash = mix(hash, (uint64_t) (uintptr_t) getAttrib(x, R_DimSymbol));
+        hash = mix(hash, (uint64_t) (uintptr_t) getAttrib(x, R_ClassSymbol));
+    }
+    if (TYPEOF(x) == VECSXP) {
+        const R_xlen_t n = XLENGTH(x);
+        for (R_xlen_t i = 0; i < n; ++i) {
+            hash = mix(hash, (uint64_t) (uintptr_t) VECTOR_ELT(x, i));
+        }
+    }
+    return hash;
+}
+
+SEXP qide_fingerprint(SEXP env, SEXP names)
+{
+    if (!isEnvironment(env) || !isString(names)) {
+        error("expected an environment and a character vector");
+    }
+
+    const R_xlen_t n = XLENGTH(names);
+    SEXP result = PROTECT(allocVector(STRSXP, n));
+    char buffer[24];
+
+    for (R_xlen_t i = 0; i < n; ++i) {
+        SEXP sym = installChar(STRING_ELT(names, i));
+        if (R_BindingIsActive(sym, env)) {
+            // Reading an active binding runs code; treat it as stable. The
+            // name's cached CHARSXP keeps the key unique per binding.
+            snprintf(buffer, sizeof(buffer), "a%016llx",
+                     (unsigned long long) (uintptr_t) STRING_ELT(names, i));
+            SET_STRING_ELT(result, i, mkChar(buffer));
+            continue;
+        }
+
+        SEXP value = findVarInFrame3(env, sym, TRUE);
+        if (TYPEOF(value) == PROMSXP) {
+            // Unforced promises are fingerprinted as themselves; they get a
+            // new fingerprint once forced
+            SEXP forced = PRVALUE(value);
+            if (forced != R_UnboundValue) {
+                value = forced;
+            }
+        }
+
+        snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) fingerprint(value));
+        SET_STRING_ELT(result, i, mkChar(buffer));
+    }
+
+    UNPROTECT(1);
+    return result;
+}
@@ -0,0 +1,33 @@
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+
+extern SEXP qide_connect(SEXP path);
+extern SEXP qide_send(SEXP fd, SEXP data);
+extern SEXP qide_close(SEXP fd);
+extern SEXP qide_fingerprint(SEXP env, SEXP names);
+extern SEXP qide_watch(SEXP fd, SEXP fun);
+extern SEXP qide_unwatch(void);
+extern SEXP qide_stdin_pending(void);
+extern SEXP qide_shm_write(SEXP name, SEXP columns, SEXP nrows);
+extern SEXP qide_shm_unlink(SEXP name);
+
+static const R_CallMethodDef CallEntries[] = {
+    {"C_qide_connect", (DL_FUNC) &qide_connect, 1},
+    {"C_qide_send", (DL_FUNC) &qide_send, 2},
+    {"C_qide_close", (DL_FUNC) &qide_close, 1},
+    {"C_qide_fingerprint", (DL_FUNC) &qide_fingerprint, 2},
+    {"C_qide_watch", (DL_FUNC) &qide_watch, 2},
+    {"C_qide_unwatch", (DL_FUNC) &qide_unwatch, 0},
+    {"C_qide_stdin_pending", (DL_FUNC) &qide_stdin_pending, 0},
+    {"C_qide_shm_write", (DL_FUNC) &qide_shm_write, 3},
+    {"C_qide_shm_unlink", (DL_FUNC) &qide_shm_unlink, 1},
+    {NULL, NULL, 0}
+};
+
+void R_init_qide(DllInfo *dll)
+{
+    R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+    R_forceSymbols(dll, TRUE);
+}
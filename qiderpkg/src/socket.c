@@ -0,0 +1,189 @@
+// Minimal client for the per-session local socket Q listens on. R has no
+// built-in support for Unix domain sockets, so connect/send/close live
+// here and the framing is done in R (see R/core.R). Messages from Q are
+// picked up by an input handler, which R runs while it waits at the
+// prompt, so they never interrupt user code.
+
+#include <R.h>
+#include <Rinternals.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <R_ext/eventloop.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+SEXP qide_connect(SEXP path)
+{
+#ifdef _WIN32
+    return ScalarInteger(-1);
+#else
+    if (!isString(path) || LENGTH(path) != 1) {
+        error("path must be a single string");
+    }
+    const char *p = translateCharUTF8(STRING_ELT(path, 0));
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(p) >= sizeof(addr.sun_path)) {
+        return ScalarInteger(-1);
+    }
+    strcpy(addr.sun_path, p);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return ScalarInteger(-1);
+    }
+    // Child processes started from R (system(), parallel) must not keep
+    // the channel open
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return ScalarInteger(-1);
+    }
+    return ScalarInteger(fd);
+#endif
+}
+
+SEXP qide_send(SEXP fd, SEXP data)
+{
+#ifdef _WIN32
+    return ScalarLogical(FALSE);
+#else
+    if (TYPEOF(data) != RAWSXP) {
+        error("data must be a raw vector");
+    }
+    const int s = asInteger(fd);
+    if (s < 0) {
+        return ScalarLogical(FALSE);
+    }
+
+    const unsigned char *p = RAW(data);
+    R_xlen_t remaining = XLENGTH(data);
+    while (remaining > 0) {
+        ssize_t n = send(s, p, (size_t) remaining, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ScalarLogical(FALSE);
+        }
+        p += n;
+        remaining -= n;
+    }
+    return ScalarLogical(TRUE);
+#endif
+}
+
+SEXP qide_close(SEXP fd)
+{
+#ifndef _WIN32
+    const int s = asInteger(fd);
+    if (s >= 0) {
+        close(s);
+    }
+#endif
+    return R_NilValue;
+}
+
+#ifndef _WIN32
+static InputHandler *handler = NULL;
+static SEXP callback = NULL;
+
+static void run_callback(void *call)
+{
+    eval((SEXP) call, R_GlobalEnv);
+}
+
+static void unwatch(void)
+{
+    if (handler) {
+        removeInputHandler(&R_InputHandlers, handler);
+        handler = NULL;
+    }
+    if (callback) {
+        R_ReleaseObject(callback);
+        callback = NULL;
+    }
+}
+
+static void on_readable(void *data)
+{
+    (void) data;
+    unsigned char buffer[65536];
+    ssize_t n = recv(handler->fileDescriptor, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        // Q closed the channel; stop polling a dead descriptor
+        unwatch();
+        return;
+    }
+
+    SEXP bytes = PROTECT(allocVector(RAWSXP, n));
+    memcpy(RAW(bytes), buffer, (size_t) n);
+    SEXP call = PROTECT(lang2(callback, bytes));
+    // Errors in the callback must not unwind into the event loop
+    R_ToplevelExec(run_callback, call);
+    UNPROTECT(2);
+}
+#endif
+
+SEXP qide_watch(SEXP fd, SEXP fun)
+{
+#ifndef _WIN32
+    if (!isFunction(fun)) {
+        error("fun must be a function");
+    }
+    unwatch();
+    const int s = asInteger(fd);
+    if (s < 0) {
+        return ScalarLogical(FALSE);
+    }
+    callback = fun;
+    R_PreserveObject(callback);
+    handler = addInputHandler(R_InputHandlers, s, on_readable, 42);
+    return ScalarLogical(handler != NULL);
+#else
+    return ScalarLogical(FALSE);
+#endif
+}
+
+// Whether console input is waiting to be read. R's readline reads stdin
+// one character at a time, so the rest of a pasted chunk stays in the
+// terminal's buffer until R gets to it.
+SEXP qide_stdin_pending(void)
+{
+#ifndef _WIN32
+    struct pollfd p;
+    p.fd = STDIN_FILENO;
+    p.events = POLLIN;
+    p.revents = 0;
+    if (poll(&p, 1, 0) > 0 && (p.revents & POLLIN)) {
+        return ScalarLogical(TRUE);
+    }
+#endif
+    return ScalarLogical(FALSE);
+}
+
+SEXP qide_unwatch(void)
+{
+#ifndef _WIN32
+    unwatch();
+#endif
+    return R_NilValue;
+}
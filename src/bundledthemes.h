@@ -0,0 +1,25 @@
+#ifndef BUNDLEDTHEMES_H
+#define BUNDLEDTHEMES_H
+
+// Gogh themes compiled into the binary. The table is generated at build
+// time from gogh-themes/*.json by cmake/GenerateThemes.cmake.
+struct BundledTheme {
+    // Indices into colors
+    enum Color {
+        Background, Foreground, Cursor,
+        Ansi01, Ansi02, Ansi03, Ansi04, Ansi05, Ansi06, Ansi07, Ansi08,
+        Ansi09, Ansi10, Ansi11, Ansi12, Ansi13, Ansi14, Ansi15, Ansi16,
+        ColorCount
+    };
+
+    const char *name;
+    const char *author;
+    const char *variant;
+    // 0xRRGGBB, or -1 when the source file did not define the color
+    int colors[ColorCount];
+};
+
+extern const BundledTheme bundledThemes[];
+extern const int bundledThemeCount;
+
+#endif // BUNDLEDTHEMES_H
@@ -27,8 +27,8 @@ CodeEditor::CodeEditor(QWidget *parent)
     // Set tab width (4 spaces)
     setTabStopDistance(fontMetrics().horizontalAdvance(' ') * 4);
     
-    // Apply theme colors
-    setStyleSheet(ThemeManager::instance().toStyleSheet(currentTheme));
+    // Colors come from the application stylesheet and palette; the editor
+    // itself only owns its highlighter formats and line decorations
     
     // Create syntax highlighter with theme
     highlighter = new RSyntaxHighlighter(document());
@@ -41,6 +41,8 @@ CodeEditor::CodeEditor(QWidget *parent)
             this, &CodeEditor::updateLineNumberArea);
     connect(this, &CodeEditor::cursorPositionChanged,
             this, &CodeEditor::highlightCurrentLine);
+    connect(this, &CodeEditor::updateRequest,
+            this, &CodeEditor::updateVisibleBlocks);
     
     updateLineNumberAreaWidth(0);
     highlightCurrentLine();
@@ -75,6 +77,16 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
         updateLineNumberAreaWidth(0);
 }
 
+void CodeEditor::updateVisibleBlocks()
+{
+    // Tell the highlighter what is on screen so background results for
+    // large documents are applied there first
+    if (!highlighter) return;
+    const int first = firstVisibleBlock().blockNumber();
+    const int last = cursorForPosition(QPoint(0, viewport()->height() - 1)).blockNumber();
+    highlighter->setVisibleBlockRange(first, last);
+}
+
 void CodeEditor::resizeEvent(QResizeEvent *e)
 {
     QPlainTextEdit::resizeEvent(e);
@@ -103,16 +115,41 @@ void CodeEditor::highlightCurrentLine()
 
 void CodeEditor::setTheme(const EditorTheme &theme)
 {
+    applyThemeColors(theme);
+    if (highlighter) {
+        highlighter->rehighlightProgressively();
+    }
+}
+
+void CodeEditor::previewTheme(const EditorTheme &theme)
+{
+    applyThemeColors(theme);
+    if (highlighter) {
+        updateVisibleBlocks();
+        highlighter->rehighlightVisible();
+    }
+}
+
+void CodeEditor::applyThemeColors(const EditorTheme &theme)
+{
+    // Only formats and self-painted decorations change here; backgrounds
+    // come from the application stylesheet and palette
     currentTheme = theme;
-    setStyleSheet(ThemeManager::instance().toStyleSheet(theme));
     if (highlighter) {
         highlighter->setTheme(theme);
-        highlighter->rehighlight();
     }
     highlightCurrentLine();
+    lineNumberArea->update();
     viewport()->update();
 }
 
+void CodeEditor::setMarkdownMode(bool enabled)
+{
+    if (highlighter) {
+        highlighter->setMarkdownMode(enabled);
+    }
+}
+
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
     QPainter painter(lineNumberArea);
@@ -19,6 +19,9 @@ public:
     void lineNumberAreaPaintEvent(QPaintEvent *event);
     int lineNumberAreaWidth();
     void setTheme(const EditorTheme &theme);
+    // Cheaper setTheme for live previews: recolors only what is on screen
+    void previewTheme(const EditorTheme &theme);
+    void setMarkdownMode(bool enabled);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
@@ -27,8 +30,11 @@ private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &rect, int dy);
+    void updateVisibleBlocks();
 
 private:
+    void applyThemeColors(const EditorTheme &theme);
+
     QWidget *lineNumberArea;
     RSyntaxHighlighter *highlighter;
     EditorTheme currentTheme;
@@ -0,0 +1,172 @@
+#include "dataframemodel.h"
+#include <climits>
+
+DataFrameModel::DataFrameModel(SessionChannel *channel, const QStringList &path, QObject *parent)
+    : QAbstractTableModel(parent), channel(channel), path(path), tiles(MaxCachedCells)
+{
+    static quint32 viewCounter = 0;
+    viewId = ++viewCounter;
+
+    if (channel) {
+        connect(channel, &SessionChannel::tableInfoReceived, this, &DataFrameModel::onTableInfo);
+        connect(channel, &SessionChannel::tablePageReceived, this, &DataFrameModel::onTablePage);
+    }
+    query();
+}
+
+DataFrameModel::~DataFrameModel()
+{
+    // Let R drop its reference to the object
+    if (channel) {
+        channel->closeTable(viewId);
+    }
+}
+
+void DataFrameModel::setFilter(const QString &expression)
+{
+    if (expression == filterExpression) return;
+    filterExpression = expression;
+    query();
+}
+
+void DataFrameModel::sort(int column, Qt::SortOrder order)
+{
+    if (column == sortColumn && order == sortOrder) return;
+    sortColumn = column;
+    sortOrder = order;
+    query();
+}
+
+void DataFrameModel::query()
+{
+    // Tiles of the previous order are useless now; replies to requests
+    // still in flight are recognised by their generation and ignored
+    ++generation;
+    tiles.clear();
+    queued.clear();
+    inFlight.clear();
+
+    if (!channel || !channel->queryTable(viewId, generation, path, sortColumn,
+                                         sortOrder == Qt::DescendingOrder, filterExpression)) {
+        error = tr("The R session is not connected");
+        emit queryFinished();
+    }
+}
+
+void DataFrameModel::onTableInfo(const DataTableInfo &info)
+{
+    if (info.viewId != viewId || info.generation != generation) return;
+
+    error = info.error;
+    total = info.totalRows;
+    const int newRows = int(qMin(info.rows, double(INT_MAX)));
+
+    if (newRows == rows && info.columnNames == columnNames) {
+        // Same shape (a sort): keep the scroll position and repaint
+        columnTypes = info.columnTypes;
+        if (rows > 0 && !columnNames.isEmpty()) {
+            emit dataChanged(index(0, 0), index(rows - 1, columnNames.size() - 1));
+        }
+        emit headerDataChanged(Qt::Vertical, 0, qMax(0, rows - 1));
+    } else {
+        beginResetModel();
+        rows = newRows;
+        columnNames = info.columnNames;
+        columnTypes = info.columnTypes;
+        endResetModel();
+    }
+    emit queryFinished();
+}
+
+void DataFrameModel::onTablePage(const DataTablePage &page)
+{
+    if (page.viewId != viewId || page.generation != generation) return;
+
+    const int number = int(page.firstRow) / PageRows;
+    const int block = page.firstColumn / PageColumns;
+    const quint64 key = tileKey(number, block);
+    inFlight.remove(key);
+    const int first = number * PageRows;
+    const int firstColumn = block * PageColumns;
+    if (page.rowCount > 0 && page.firstColumn == firstColumn
+        && page.columnCount == qMin(PageColumns, int(columnNames.size()) - firstColumn)) {
+        const int cost = page.rowCount * page.columnCount;
+        tiles.insert(key, new DataTablePage(page), qBound(1, cost, MaxCachedCells));
+        emit dataChanged(index(first, firstColumn),
+                         index(first + page.rowCount - 1, firstColumn + page.columnCount - 1),
+                         {Qt::DisplayRole});
+    }
+    sendRequests();
+}
+
+void DataFrameModel::wantTile(int page, int block) const
+{
+    if (page < 0 || qint64(page) * PageRows >= rows) return;
+    if (block < 0 || qint64(block) * PageColumns >= columnNames.size()) return;
+    const quint64 key = tileKey(page, block);
+    if (tiles.contains(key) || inFlight.contains(key)) return;
+
+    queued.removeOne(key);
+    queued.append(key);
+    while (queued.size() > MaxQueued) {
+        queued.removeFirst();
+    }
+}
+
+void DataFrameModel::sendRequests() const
+{
+    while (inFlight.size() < MaxInFlight && !queued.isEmpty()) {
+        const quint64 key = queued.takeLast();
+        const int page = int(key >> 32);
+        const int block = int(quint32(key));
+        if (!channel || !channel->requestTableRows(viewId, generation, double(page) * PageRows, PageRows,
+                                                   quint32(block) * PageColumns, PageColumns)) {
+            queued.clear();
+            return;
+        }
+        inFlight.insert(key);
+    }
+}
+
+int DataFrameModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows;
+}
+
+int DataFrameModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : columnNames.size();
+}
+
+QVariant DataFrameModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole) return QVariant();
+
+    const int number = index.row() / PageRows;
+    const int block = index.column() / PageColumns;
+    if (const DataTablePage *page = tiles.object(tileKey(number, block))) {
+        const int row = index.row() - number * PageRows;
+        const int column = index.column() - block * PageColumns;
+        if (row < page->rowCount && column < page->columnCount) return page->cell(row, column);
+        return QVariant();
+    }
+
+    // Not loaded yet: queue the tiles above and below for prefetching,
+    // then this one, so it is requested first
+    wantTile(number + 1, block);
+    wantTile(number - 1, block);
+    wantTile(number, block);
+    sendRequests();
+    return QVariant();
+}
+
+QVariant DataFrameModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Vertical) {
+        return role == Qt::DisplayRole ? QVariant(section + 1) : QVariant();
+    }
+    if (section < 0 || section >= columnNames.size()) return QVariant();
+    if (role == Qt::DisplayRole) return columnNames.at(section);
+    if (role == Qt::ToolTipRole) return columnTypes.value(section);
+    return QVariant();
+}
@@ -0,0 +1,86 @@
+#ifndef DATAFRAMEMODEL_H
+#define DATAFRAMEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include <QStringList>
+#include "sessionchannel.h"
+
+// A data frame or matrix living in the R session. Cells are fetched from
+// R a tile (a block of rows by a block of columns) at a time as the view
+// asks for them and kept in an LRU cache of bounded size, so memory in Q
+// grows neither with the rows nor with the columns of the object.
+// Sorting and filtering are done by R, which keeps the row order per
+// view.
+class DataFrameModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    static constexpr int PageRows = 128;
+    static constexpr int PageColumns = 64;
+    // Cache budget, counted in cells: 64 full tiles, far more than a
+    // screen and its prefetched neighbours need
+    static constexpr int MaxCachedCells = 1 << 19;
+
+    DataFrameModel(SessionChannel *channel, const QStringList &path, QObject *parent = nullptr);
+    ~DataFrameModel();
+
+    void setFilter(const QString &expression);
+    QString filter() const { return filterExpression; }
+    QString errorString() const { return error; }
+    double totalRows() const { return total; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    // A query finished; row count or error may have changed
+    void queryFinished();
+
+private slots:
+    void onTableInfo(const DataTableInfo &info);
+    void onTablePage(const DataTablePage &page);
+
+private:
+    // Requests R works on at once. Tiles scrolled past while waiting are
+    // dropped from the queue, newest first, so fast scrolling does not
+    // leave R formatting rows nobody looks at.
+    static constexpr int MaxInFlight = 2;
+    static constexpr int MaxQueued = 8;
+
+    // Tiles are keyed by row page in the high and column block in the
+    // low 32 bits
+    static quint64 tileKey(int page, int block) { return (quint64(page) << 32) | quint32(block); }
+
+    void query();
+    void wantTile(int page, int block) const;
+    void sendRequests() const;
+
+    QPointer<SessionChannel> channel;
+    QStringList path;
+    quint32 viewId;
+    quint32 generation = 0;
+
+    int sortColumn = -1;
+    Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    QString filterExpression;
+
+    int rows = 0;
+    double total = 0;
+    QStringList columnNames;
+    QStringList columnTypes;
+    QString error;
+
+    mutable QCache<quint64, DataTablePage> tiles;
+    mutable QList<quint64> queued;
+    mutable QSet<quint64> inFlight;
+};
+
+#endif // DATAFRAMEMODEL_H
@@ -0,0 +1,70 @@
+#include "dataviewer.h"
+#include "dataframemodel.h"
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QLocale>
+#include <QTableView>
+#include <QVBoxLayout>
+
+DataViewer::DataViewer(SessionChannel *channel, const QStringList &path, QWidget *parent)
+    : QWidget(parent)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    // Filter bar
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter rows with an R expression, e.g. x > 0 & !is.na(y)"));
+    filterEdit->setClearButtonEnabled(true);
+    statusLabel = new QLabel(tr("Loading..."), this);
+    filterLayout->addWidget(filterEdit, 1);
+    filterLayout->addWidget(statusLabel);
+    layout->addLayout(filterLayout);
+
+    model = new DataFrameModel(channel, path, this);
+
+    table = new QTableView(this);
+    table->setModel(model);
+    table->setWordWrap(false);
+    // Fixed row heights let the view map millions of rows to pixels
+    // without measuring them
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->verticalHeader()->setDefaultSectionSize(fontMetrics().height() + 6);
+    // No sort until a header is clicked
+    table->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    table->setSortingEnabled(true);
+    layout->addWidget(table);
+
+    connect(filterEdit, &QLineEdit::returnPressed, this, [this]() {
+        model->setFilter(filterEdit->text().trimmed());
+    });
+    // Clearing the box drops the filter right away
+    connect(filterEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        if (text.isEmpty()) model->setFilter(QString());
+    });
+    connect(model, &DataFrameModel::queryFinished, this, &DataViewer::updateStatus);
+
+    updateStatus();
+}
+
+void DataViewer::updateStatus()
+{
+    if (!model->errorString().isEmpty()) {
+        statusLabel->setText(model->errorString());
+        return;
+    }
+    if (model->columnCount() == 0) return;
+
+    const QString total = QLocale().toString(model->totalRows(), 'f', 0);
+    if (model->filter().isEmpty()) {
+        statusLabel->setText(tr("%1 rows, %2 columns").arg(total).arg(model->columnCount()));
+    } else {
+        statusLabel->setText(tr("%1 of %2 rows, %3 columns")
+            .arg(QLocale().toString(model->rowCount()))
+            .arg(total)
+            .arg(model->columnCount()));
+    }
+}
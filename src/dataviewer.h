@@ -0,0 +1,32 @@
+#ifndef DATAVIEWER_H
+#define DATAVIEWER_H
+
+#include <QWidget>
+#include <QStringList>
+
+class QLabel;
+class QLineEdit;
+class QTableView;
+class DataFrameModel;
+class SessionChannel;
+
+// Tab showing a data frame or matrix from the R session. Only the rows on
+// screen are fetched; sorting (click a header) and filtering (an R
+// expression over the columns, e.g. "mpg > 20 & cyl == 4") run in R.
+class DataViewer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    DataViewer(SessionChannel *channel, const QStringList &path, QWidget *parent = nullptr);
+
+private:
+    void updateStatus();
+
+    DataFrameModel *model;
+    QTableView *table;
+    QLineEdit *filterEdit;
+    QLabel *statusLabel;
+};
+
+#endif // DATAVIEWER_H
@@ -0,0 +1,390 @@
+#include "environmentmodel.h"
+#include <algorithm>
+
+namespace {
+
+// Everything R reports about an object but its size
+bool sameObject(const EnvironmentEntry &a, const EnvironmentEntry &b)
+{
+    return a.type == b.type && a.dim == b.dim && a.length == b.length && a.expandable == b.expandable;
+}
+
+} // namespace
+
+EnvironmentModel::EnvironmentModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+}
+
+EnvironmentModel::~EnvironmentModel()
+{
+    for (Node *node : root.children) deleteNode(node);
+}
+
+void EnvironmentModel::setSnapshot(const EnvironmentSnapshot &snapshot)
+{
+    beginResetModel();
+    for (Node *node : root.children) deleteNode(node);
+    root.children.clear();
+    nodeByName.clear();
+    requests.clear();
+    pendingSizes = 0;
+
+    root.children.reserve(snapshot.entries.size());
+    for (const EnvironmentEntry &entry : snapshot.entries) {
+        Node *node = new Node;
+        node->parent = &root;
+        node->row = root.children.size();
+        node->key = entry.name;
+        describe(*node, entry);
+        root.children.append(node);
+        nodeByName.insert(entry.name, node);
+        if (entry.size < 0) ++pendingSizes;
+    }
+    endResetModel();
+}
+
+void EnvironmentModel::applyDelta(const EnvironmentDelta &delta)
+{
+    removeRowsByName(delta.removed);
+
+    // Changed objects are updated in place and keep their check state
+    QVector<const EnvironmentEntry*> added;
+    for (const EnvironmentEntry &entry : delta.entries) {
+        Node *node = nodeByName.value(entry.name);
+        if (!node) {
+            added.append(&entry);
+            continue;
+        }
+        // A size that was computed later leaves the object as it was, so
+        // an expanded row keeps its children
+        const bool sized = node->entry.size < 0 && entry.size >= 0 && sameObject(node->entry, entry);
+        if (node->entry.size < 0) --pendingSizes;
+        describe(*node, entry);
+        if (entry.size < 0) ++pendingSizes;
+        if (sized) {
+            const QModelIndex size = index(node->row, SizeColumn);
+            emit dataChanged(size, size);
+            continue;
+        }
+        resetChildren(node);
+        emit dataChanged(indexFor(node), index(node->row, ColumnCount - 1));
+    }
+
+    if (added.isEmpty()) return;
+
+    const int first = root.children.size();
+    beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+    for (const EnvironmentEntry *entry : added) {
+        Node *node = new Node;
+        node->parent = &root;
+        node->row = root.children.size();
+        node->key = entry->name;
+        describe(*node, *entry);
+        root.children.append(node);
+        nodeByName.insert(entry->name, node);
+        if (entry->size < 0) ++pendingSizes;
+    }
+    endInsertRows();
+}
+
+void EnvironmentModel::addChildren(const EnvironmentChildren &children)
+{
+    Node *node = requests.take(children.requestId);
+    if (!node) return;  // the object changed or went away meanwhile
+
+    node->request = 0;
+    node->childCount = children.total;
+    if (children.offset != quint32(node->children.size()) || children.entries.isEmpty()) {
+        // Nothing to add; an empty object loses its expander
+        const QModelIndex index = indexFor(node);
+        emit dataChanged(index, index);
+        return;
+    }
+
+    const int first = node->children.size();
+    beginInsertRows(indexFor(node), first, first + children.entries.size() - 1);
+    for (int i = 0; i < children.entries.size(); ++i) {
+        Node *child = new Node;
+        child->parent = node;
+        child->row = node->children.size();
+        child->key = children.keys.at(i);
+        describe(*child, children.entries.at(i));
+        node->children.append(child);
+    }
+    endInsertRows();
+}
+
+void EnvironmentModel::requestChildren(Node *node)
+{
+    node->request = nextRequest++;
+    if (nextRequest == 0) nextRequest = 1;
+    requests.insert(node->request, node);
+
+    emit childrenRequested(node->request, path(indexFor(node)), quint32(node->children.size()), PageSize);
+}
+
+void EnvironmentModel::resetChildren(Node *node)
+{
+    // Children of a changed object are stale. Objects that had been
+    // drilled into get their first page again, so open rows stay current.
+    const bool fetched = node->childCount >= 0 || node->request != 0;
+    if (!node->children.isEmpty()) {
+        beginRemoveRows(indexFor(node), 0, node->children.size() - 1);
+        for (Node *child : node->children) deleteNode(child);
+        node->children.clear();
+        endRemoveRows();
+    }
+    if (node->request) {
+        requests.remove(node->request);
+        node->request = 0;
+    }
+    node->childCount = -1;
+    if (fetched && node->entry.expandable) {
+        requestChildren(node);
+    }
+}
+
+void EnvironmentModel::deleteNode(Node *node)
+{
+    for (Node *child : node->children) deleteNode(child);
+    if (node->request) requests.remove(node->request);
+    delete node;
+}
+
+void EnvironmentModel::removeRowsByName(const QStringList &names)
+{
+    QVector<int> doomed;
+    doomed.reserve(names.size());
+    for (const QString &name : names) {
+        if (Node *node = nodeByName.value(name)) doomed.append(node->row);
+    }
+    if (doomed.isEmpty()) return;
+
+    // Remove contiguous runs from the back so earlier indices stay valid
+    std::sort(doomed.begin(), doomed.end());
+    int end = doomed.size() - 1;
+    while (end >= 0) {
+        int start = end;
+        while (start > 0 && doomed[start - 1] == doomed[start] - 1) --start;
+
+        const int firstRow = doomed[start];
+        const int lastRow = doomed[end];
+        beginRemoveRows(QModelIndex(), firstRow, lastRow);
+        for (int r = firstRow; r <= lastRow; ++r) {
+            Node *node = root.children[r];
+            if (node->entry.size < 0) --pendingSizes;
+            nodeByName.remove(node->entry.name);
+            deleteNode(node);
+        }
+        root.children.remove(firstRow, lastRow - firstRow + 1);
+        // Views call parent() on the children of the rows below while
+        // handling the signal, so their row must be current by then
+        reindexFrom(firstRow);
+        endRemoveRows();
+
+        end = start - 1;
+    }
+}
+
+void EnvironmentModel::reindexFrom(int first)
+{
+    for (int r = first; r < root.children.size(); ++r) {
+        root.children[r]->row = r;
+    }
+}
+
+void EnvironmentModel::describe(Node &node, const EnvironmentEntry &entry)
+{
+    node.entry = entry;
+
+    // Only show details for specific types
+    node.details.clear();
+    if (entry.type != "function" && entry.type != "environment") {
+        if (!entry.dim.isEmpty()) {
+            QStringList dimStrs;
+            for (double d : entry.dim) dimStrs << QString::number(qint64(d));
+            node.details = dimStrs.join("x");
+        } else {
+            node.details = QString::number(qint64(entry.length));
+        }
+    }
+
+    node.size = entry.size < 0 ? tr("computing…") : formatSize(entry.size);
+}
+
+QStringList EnvironmentModel::checkedNames() const
+{
+    QStringList names;
+    for (const Node *node : root.children) {
+        if (node->checked == Qt::Checked) names << node->entry.name;
+    }
+    return names;
+}
+
+QStringList EnvironmentModel::path(const QModelIndex &index) const
+{
+    QStringList result;
+    if (!index.isValid()) return result;
+    for (const Node *n = nodeFor(index); n != &root; n = n->parent) {
+        result.prepend(n->key);
+    }
+    return result;
+}
+
+bool EnvironmentModel::isTable(const QModelIndex &index) const
+{
+    return index.isValid() && nodeFor(index)->entry.dim.size() == 2;
+}
+
+QString EnvironmentModel::formatSize(double bytes)
+{
+    if (bytes < 1024) {
+        return QString::number(bytes) + " B";
+    } else if (bytes < 1024 * 1024) {
+        return QString::number(bytes / 1024.0, 'f', 2) + " KB";
+    } else if (bytes < 1024 * 1024 * 1024) {
+        return QString::number(bytes / (1024.0 * 1024.0), 'f', 2) + " MB";
+    } else {
+        return QString::number(bytes / (1024.0 * 1024.0 * 1024.0), 'f', 2) + " GB";
+    }
+}
+
+EnvironmentModel::Node *EnvironmentModel::nodeFor(const QModelIndex &index) const
+{
+    if (!index.isValid()) return const_cast<Node*>(&root);
+    return static_cast<Node*>(index.internalPointer());
+}
+
+QModelIndex EnvironmentModel::indexFor(Node *node) const
+{
+    if (node == &root) return QModelIndex();
+    return createIndex(node->row, 0, node);
+}
+
+QModelIndex EnvironmentModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return QModelIndex();
+    const Node *p = nodeFor(parent);
+    if (row < 0 || row >= p->children.size() || column < 0 || column >= ColumnCount) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, p->children[row]);
+}
+
+QModelIndex EnvironmentModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexFor(nodeFor(child)->parent);
+}
+
+int EnvironmentModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return 0;
+    return nodeFor(parent)->children.size();
+}
+
+int EnvironmentModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+bool EnvironmentModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return false;
+    const Node *node = nodeFor(parent);
+    if (node == &root) return !root.children.isEmpty();
+    // Children are only known once fetched; until then trust R's flag
+    return node->entry.expandable && node->childCount != 0;
+}
+
+bool EnvironmentModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid() || parent.column() > 0) return false;
+    const Node *node = nodeFor(parent);
+    return node->entry.expandable && node->request == 0
+        && (node->childCount < 0 || node->children.size() < node->childCount);
+}
+
+void EnvironmentModel::fetchMore(const QModelIndex &parent)
+{
+    if (canFetchMore(parent)) {
+        requestChildren(nodeFor(parent));
+    }
+}
+
+QVariant EnvironmentModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    const Node *node = nodeFor(index);
+    const bool topLevel = node->parent == &root;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case NameColumn: return node->entry.name;
+        case TypeColumn: return node->entry.type;
+        case DetailsColumn: return node->details;
+        case SizeColumn: return node->size;
+        }
+        break;
+    case Qt::CheckStateRole:
+        if (index.column() == NameColumn && topLevel) return node->checked;
+        break;
+    case Qt::TextAlignmentRole:
+        if (index.column() == SizeColumn) return int(Qt::AlignRight | Qt::AlignVCenter);
+        break;
+    case SortRole:
+        switch (index.column()) {
+        case NameColumn:
+            // Children keep R's order (element index, slot order) when
+            // sorted by name
+            if (!topLevel) return node->row;
+            return node->entry.name;
+        case TypeColumn: return node->entry.type;
+        case DetailsColumn: {
+            double count = node->entry.dim.isEmpty() ? node->entry.length : 1;
+            for (double d : node->entry.dim) count *= d;
+            return count;
+        }
+        case SizeColumn: return node->entry.size;
+        }
+        break;
+    }
+    return QVariant();
+}
+
+bool EnvironmentModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.column() != NameColumn || role != Qt::CheckStateRole) {
+        return false;
+    }
+    Node *node = nodeFor(index);
+    if (node->parent != &root) return false;
+    node->checked = Qt::CheckState(value.toInt());
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    return true;
+}
+
+Qt::ItemFlags EnvironmentModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) return Qt::NoItemFlags;
+    Qt::ItemFlags f = Qt::ItemIsEnabled;
+    // Only whole objects can be checked for deletion
+    if (index.column() == NameColumn && nodeFor(index)->parent == &root) {
+        f |= Qt::ItemIsUserCheckable;
+    }
+    return f;
+}
+
+QVariant EnvironmentModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+    switch (section) {
+    case NameColumn: return tr("Name");
+    case TypeColumn: return tr("Type");
+    case DetailsColumn: return tr("Length/Dim");
+    case SizeColumn: return tr("Size");
+    }
+    return QVariant();
+}
@@ -0,0 +1,96 @@
+#ifndef ENVIRONMENTMODEL_H
+#define ENVIRONMENTMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include "sessionchannel.h"
+
+// Objects of the R global environment. Top-level rows stay put across
+// updates: a delta only touches the rows it names, new objects are
+// appended and ordering is left to a QSortFilterProxyModel on top.
+//
+// Expandable objects get their children (list elements, data frame
+// columns, S4 slots, environment members) from R on demand, a page at a
+// time, through canFetchMore()/fetchMore().
+class EnvironmentModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { NameColumn, TypeColumn, DetailsColumn, SizeColumn, ColumnCount };
+
+    // Numeric sort key per column (size in bytes, element count), so
+    // sorting by size or length is not alphabetical
+    static constexpr int SortRole = Qt::UserRole;
+
+    // Children requested per fetchMore()
+    static constexpr quint32 PageSize = 200;
+
+    explicit EnvironmentModel(QObject *parent = nullptr);
+    ~EnvironmentModel();
+
+    void setSnapshot(const EnvironmentSnapshot &snapshot);
+    void applyDelta(const EnvironmentDelta &delta);
+    void addChildren(const EnvironmentChildren &children);
+
+    QStringList checkedNames() const;
+    // Path R resolves the object at index by (see childrenRequested)
+    QStringList path(const QModelIndex &index) const;
+    // Two-dimensional objects (data frames, matrices) can be viewed
+    bool isTable(const QModelIndex &index) const;
+    static QString formatSize(double bytes);
+    bool hasPendingSizes() const { return pendingSizes > 0; }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+signals:
+    // The owner forwards this to R (SessionChannel::requestChildren) and
+    // hands the reply to addChildren()
+    void childrenRequested(quint32 requestId, const QStringList &path, quint32 offset, quint32 count);
+
+private:
+    struct Node {
+        EnvironmentEntry entry;
+        // Path element R resolves this node by; the name for top-level rows
+        QString key;
+        QString details;
+        QString size;
+        Node *parent = nullptr;
+        int row = 0;
+        QVector<Node*> children;
+        // Total children reported by R, -1 until the first page arrives
+        double childCount = -1;
+        // Outstanding children request, 0 if none
+        quint32 request = 0;
+        Qt::CheckState checked = Qt::Unchecked;
+    };
+
+    Node *nodeFor(const QModelIndex &index) const;
+    QModelIndex indexFor(Node *node) const;
+    static void describe(Node &node, const EnvironmentEntry &entry);
+    void requestChildren(Node *node);
+    void resetChildren(Node *node);
+    void deleteNode(Node *node);
+    void removeRowsByName(const QStringList &names);
+    void reindexFrom(int first);
+
+    Node root;
+    QHash<QString, Node*> nodeByName;
+    QHash<quint32, Node*> requests;
+    quint32 nextRequest = 1;
+    int pendingSizes = 0;
+};
+
+#endif // ENVIRONMENTMODEL_H
@@ -1,15 +1,36 @@
 #include "environmentpane.h"
 #include "terminalwidget.h"
+#include "sessionchannel.h"
+#include "environmentmodel.h"
 #include <QHeaderView>
+#include <QMenu>
+#include <QMessageBox>
+#include <QScrollBar>
+#include <QSortFilterProxyModel>
 #include <QDebug>
-#include <QStandardPaths>
-#include <QDir>
-#include <QFile>
 #include <QTimer>
 #ifdef Q_OS_UNIX
 #include <unistd.h>
 #endif
 
+namespace {
+
+// Filters object names only; the children of a matching object are
+// always shown
+class TopLevelFilterProxy : public QSortFilterProxyModel
+{
+public:
+    using QSortFilterProxyModel::QSortFilterProxyModel;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        return sourceParent.isValid() || QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
+    }
+};
+
+} // namespace
+
 EnvironmentPane::EnvironmentPane(TerminalWidget *terminal, QWidget *parent)
     : QWidget(parent), terminal(terminal)
 {
@@ -30,50 +51,78 @@ EnvironmentPane::EnvironmentPane(TerminalWidget *terminal, QWidget *parent)
     layout->addLayout(toolLayout);
     
     // Memory label
-    memoryLabel = new QLabel("Total size: 0 B", this);
+    memoryLabel = new QLabel("Waiting for R...", this);
     memoryLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
     layout->addWidget(memoryLabel);
 
-    // Tree Widget
-    treeWidget = new QTreeWidget(this);
-    treeWidget->setHeaderLabels(QStringList() << "Name" << "Type" << "Length/Dim" << "Size");
-    treeWidget->setSelectionMode(QAbstractItemView::NoSelection); // We use checkboxes
-    layout->addWidget(treeWidget);
+    // Filter
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText("Filter by name");
+    filterEdit->setClearButtonEnabled(true);
+    layout->addWidget(filterEdit);
+
+    // The model keeps rows stable across updates; sorting and filtering
+    // happen in the proxy, so a delta only costs the rows it touches
+    model = new EnvironmentModel(this);
+    proxy = new TopLevelFilterProxy(this);
+    proxy->setSourceModel(model);
+    proxy->setSortRole(EnvironmentModel::SortRole);
+    proxy->setSortLocaleAware(true);
+    proxy->setSortCaseSensitivity(Qt::CaseInsensitive);
+    proxy->setFilterKeyColumn(EnvironmentModel::NameColumn);
+    proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
 
-    // Initial status
-    new QTreeWidgetItem(treeWidget, QStringList() << "Status" << "Waiting for R..." << "" << "");
+    // Tree View
+    treeView = new QTreeView(this);
+    treeView->setModel(proxy);
+    // Lets the view lay out rows without asking every row for its size
+    treeView->setUniformRowHeights(true);
+    treeView->setSelectionMode(QAbstractItemView::NoSelection); // We use checkboxes
+    treeView->setSortingEnabled(true);
+    treeView->sortByColumn(EnvironmentModel::NameColumn, Qt::AscendingOrder);
+    treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+    layout->addWidget(treeView);
+
+    connect(filterEdit, &QLineEdit::textChanged, proxy, &QSortFilterProxyModel::setFilterFixedString);
+    connect(treeView->verticalScrollBar(), &QScrollBar::valueChanged, this, &EnvironmentPane::fetchVisibleChildren);
+    connect(proxy, &QAbstractItemModel::rowsInserted, this, &EnvironmentPane::fetchVisibleChildren, Qt::QueuedConnection);
 
     connect(refreshButton, &QPushButton::clicked, this, &EnvironmentPane::refreshEnvironment);
     connect(deleteButton, &QPushButton::clicked, this, &EnvironmentPane::deleteCheckedItems);
     connect(clearButton, &QPushButton::clicked, this, &EnvironmentPane::clearAllItems);
     connect(gcButton, &QPushButton::clicked, this, &EnvironmentPane::runGC);
+    connect(treeView, &QWidget::customContextMenuRequested, this, &EnvironmentPane::showContextMenu);
+    connect(treeView, &QAbstractItemView::doubleClicked, this, &EnvironmentPane::viewObject);
     
-    // Setup file watcher
-    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-    envFilePath = QDir(tempDir).filePath("q_env.json");
-    
-    // Ensure file exists so watcher can watch it
-    QFile f(envFilePath);
-    if (!f.exists()) {
-        f.open(QIODevice::WriteOnly);
-        f.write("{}");
-        f.close();
+    // qide pushes a snapshot over the session channel after every
+    // top-level command
+    if (terminal && terminal->sessionChannel()) {
+        connect(terminal->sessionChannel(), &SessionChannel::environmentReceived,
+                this, &EnvironmentPane::showEnvironment);
+        connect(terminal->sessionChannel(), &SessionChannel::environmentDeltaReceived,
+                this, &EnvironmentPane::applyEnvironmentDelta);
+        connect(terminal->sessionChannel(), &SessionChannel::childrenReceived,
+                model, &EnvironmentModel::addChildren);
+        connect(model, &EnvironmentModel::childrenRequested,
+                terminal->sessionChannel(), &SessionChannel::requestChildren);
+        connect(terminal->sessionChannel(), &SessionChannel::evalFinished,
+                this, &EnvironmentPane::showEvalResult);
     }
-    
-    fileWatcher = new QFileSystemWatcher(this);
-    fileWatcher->addPath(envFilePath);
-    
-    connect(fileWatcher, &QFileSystemWatcher::fileChanged, this, &EnvironmentPane::onEnvironmentFileChanged);
 }
 
 EnvironmentPane::~EnvironmentPane()
 {
 }
 
+QStringList EnvironmentPane::checkedNames() const
+{
+    return model->checkedNames();
+}
+
 void EnvironmentPane::refreshEnvironment()
 {
     if (!terminal) return;
-    terminal->executeCommand("if (requireNamespace('qide', quietly=TRUE)) qide::update_env()");
+    evaluate("if (requireNamespace('qide', quietly=TRUE)) qide::update_env(full = TRUE)");
 }
 
 void EnvironmentPane::deleteCheckedItems()
@@ -81,97 +130,117 @@ void EnvironmentPane::deleteCheckedItems()
     if (!terminal) return;
 
     QStringList vars;
-    for (int i = 0; i < treeWidget->topLevelItemCount(); ++i) {
-        QTreeWidgetItem *item = treeWidget->topLevelItem(i);
-        if (item->checkState(0) == Qt::Checked) {
-            vars << "\"" + item->text(0) + "\"";
-        }
+    for (QString name : model->checkedNames()) {
+        // Backticked names can hold any character
+        vars << "\"" + name.replace('\\', "\\\\").replace('"', "\\\"") + "\"";
     }
 
     if (vars.isEmpty()) return;
 
-    // Use a safer, silent command sequence
-    // 1. Check existence to avoid warnings
-    // 2. Use invisible() to avoid return value printing
-    // 3. Use local() to avoid polluting the global environment with temporary variables
+    // Skip names that are already gone to avoid warnings; qide reports
+    // the change once the code has run
     QString cmd = QString(
         "invisible(local({"
         "  to_remove <- c(%1);"
         "  to_remove <- to_remove[to_remove %in% ls(envir = .GlobalEnv)];"
         "  if (length(to_remove) > 0) rm(list = to_remove, envir = .GlobalEnv);"
-        "  if (requireNamespace('qide', quietly=TRUE)) qide::update_env();"
         "}))"
     ).arg(vars.join(", "));
     
-    terminal->executeCommand(cmd);
+    evaluate(cmd);
 }
 
 void EnvironmentPane::clearAllItems()
 {
     if (!terminal) return;
     
-    QString cmd = "invisible({ rm(list = ls(envir = .GlobalEnv), envir = .GlobalEnv); if (requireNamespace('qide', quietly=TRUE)) qide::update_env() })";
-    terminal->executeCommand(cmd);
+    evaluate("rm(list = ls(envir = .GlobalEnv), envir = .GlobalEnv)");
 }
 
 void EnvironmentPane::runGC()
 {
     if (!terminal) return;
-    terminal->executeCommand("gc()");
+    evaluate("invisible(gc())");
 }
 
-void EnvironmentPane::onEnvironmentFileChanged(const QString &path)
+void EnvironmentPane::evaluate(const QString &code)
 {
-    if (path != envFilePath) return;
-    
-    QFile file(path);
-    if (file.open(QIODevice::ReadOnly)) {
-        QByteArray data = file.readAll();
-        file.close();
-        if (data.isEmpty()) {
-             treeWidget->clear();
-             new QTreeWidgetItem(treeWidget, QStringList() << "Status" << "Environment empty" << "");
-        } else {
-             parseEnvironmentData(data);
-        }
-    } else {
-        treeWidget->clear();
-        new QTreeWidgetItem(treeWidget, QStringList() << "Error" << "Cannot read file" << "");
-    }
-    
-    // Re-add path if watcher lost it (some editors delete/recreate files)
-    if (!fileWatcher->files().contains(path)) {
-        fileWatcher->addPath(path);
+    const quint32 id = terminal->evaluate(code);
+    if (id) {
+        evalRequests.insert(id);
     }
 }
 
-void EnvironmentPane::parseEnvironmentData(const QByteArray &jsonData)
+void EnvironmentPane::showEvalResult(const EvalResult &result)
+{
+    if (!evalRequests.remove(result.requestId) || result.ok) return;
+    QMessageBox::warning(this, tr("Environment"), result.error);
+}
+
+void EnvironmentPane::showEnvironment(const EnvironmentSnapshot &snapshot)
+{
+    updateMemoryLabel(snapshot.totalSize);
+    model->setSnapshot(snapshot);
+    requestPendingSizes();
+}
+
+void EnvironmentPane::applyEnvironmentDelta(const EnvironmentDelta &delta)
+{
+    updateMemoryLabel(delta.totalSize);
+    model->applyDelta(delta);
+    requestPendingSizes();
+}
+
+void EnvironmentPane::fetchVisibleChildren()
 {
-    QJsonDocument doc = QJsonDocument::fromJson(jsonData);
-    if (doc.isNull()) {
-        treeWidget->clear();
-        new QTreeWidgetItem(treeWidget, QStringList() << "Error" << "Invalid JSON data" << "");
-        return;
+    // QTreeView only fetches more rows of the root by itself. Long lists
+    // get their next page once their last loaded child scrolls into view.
+    const int height = treeView->viewport()->height();
+    for (QModelIndex index = treeView->indexAt(QPoint(1, 1));
+         index.isValid() && treeView->visualRect(index).top() < height;
+         index = treeView->indexBelow(index)) {
+        const QModelIndex parent = index.parent();
+        if (parent.isValid() && index.row() == proxy->rowCount(parent) - 1
+            && proxy->canFetchMore(parent)) {
+            proxy->fetchMore(parent);
+        }
     }
+}
 
-    QJsonObject root = doc.object();
-    
-    if (root.contains("error")) {
-        treeWidget->clear();
-        QTreeWidgetItem *item = new QTreeWidgetItem(treeWidget);
-        item->setText(0, "Error: " + root["error"].toString());
-        return;
+void EnvironmentPane::showContextMenu(const QPoint &pos)
+{
+    const QModelIndex index = treeView->indexAt(pos);
+    if (!index.isValid()) return;
+
+    QMenu menu(this);
+    QAction *viewAction = menu.addAction(tr("View"));
+    viewAction->setEnabled(model->isTable(proxy->mapToSource(index)));
+    connect(viewAction, &QAction::triggered, this, [this, index]() { viewObject(index); });
+    menu.exec(treeView->viewport()->mapToGlobal(pos));
+}
+
+void EnvironmentPane::viewObject(const QModelIndex &proxyIndex)
+{
+    const QModelIndex index = proxy->mapToSource(proxyIndex);
+    if (!model->isTable(index)) return;
+
+    const QString name = index.siblingAtColumn(EnvironmentModel::NameColumn).data().toString();
+    emit viewRequested(model->path(index), name);
+}
+
+void EnvironmentPane::requestPendingSizes()
+{
+    // qide sizes objects within a per-prompt time budget; ask for the next
+    // slice, which R handles once it is idle at the prompt. Each reply is a
+    // delta, so this repeats until nothing is pending.
+    SessionChannel *channel = terminal ? terminal->sessionChannel() : nullptr;
+    if (channel && model->hasPendingSizes()) {
+        channel->send(SessionChannel::SizeRequestMessage);
     }
+}
 
-    QJsonArray objects = root["objects"].toArray();
-    QJsonObject types = root["types"].toObject();
-    QJsonObject dims = root["dim"].toObject();
-    QJsonObject lens = root["len"].toObject();
-    QJsonObject sizes = root["size"].toObject();
-    
-    // Update total size label
-    double totalSize = root["total_size"].toDouble();
-    
+void EnvironmentPane::updateMemoryLabel(double totalSize)
+{
     double totalRam = 0;
 #ifdef Q_OS_UNIX
     long pages = sysconf(_SC_PHYS_PAGES);
@@ -182,82 +251,10 @@ void EnvironmentPane::parseEnvironmentData(const QByteArray &jsonData)
     if (totalRam > 0) {
         double percent = (totalSize / totalRam) * 100.0;
         memoryLabel->setText(QString("Used memory: %1 out of %2 (%3%)")
-            .arg(formatSize(totalSize))
-            .arg(formatSize(totalRam))
+            .arg(EnvironmentModel::formatSize(totalSize))
+            .arg(EnvironmentModel::formatSize(totalRam))
             .arg(QString::number(percent, 'f', 1)));
     } else {
-        memoryLabel->setText("Used memory: " + formatSize(totalSize));
-    }
-
-    treeWidget->clear();
-
-    for (const auto &objVal : objects) {
-        QString name = objVal.toString();
-        
-        // Get Type
-        QString typeStr;
-        QJsonValue typeVal = types[name];
-        if (typeVal.isArray()) {
-            QJsonArray typeArr = typeVal.toArray();
-            if (!typeArr.isEmpty()) typeStr = typeArr[0].toString();
-        } else if (typeVal.isString()) {
-             typeStr = typeVal.toString();
-        }
-        
-        // Get Details (Dim or Length)
-        QString details;
-        
-        // Only show details for specific types
-        bool showDetails = true;
-        if (typeStr == "function" || typeStr == "environment") {
-            showDetails = false;
-        }
-        
-        if (showDetails) {
-            QJsonValue dimVal = dims[name];
-            if (dimVal.isArray() && !dimVal.toArray().isEmpty()) {
-                QJsonArray dimArr = dimVal.toArray();
-                QStringList dimStrs;
-                for(const auto &d : dimArr) dimStrs << QString::number(d.toInt());
-                details = dimStrs.join("x");
-            } else {
-                QJsonValue lenVal = lens[name];
-                if (lenVal.isArray() && !lenVal.toArray().isEmpty()) {
-                     details = QString::number(lenVal.toArray()[0].toInt());
-                } else if (lenVal.isDouble()) {
-                     details = QString::number(lenVal.toInt());
-                }
-            }
-        }
-        
-        // Get Size
-        double sizeBytes = 0;
-        QJsonValue sizeVal = sizes[name];
-        if (sizeVal.isArray() && !sizeVal.toArray().isEmpty()) {
-             sizeBytes = sizeVal.toArray()[0].toDouble();
-        } else if (sizeVal.isDouble()) {
-             sizeBytes = sizeVal.toDouble();
-        }
-        QString sizeStr = formatSize(sizeBytes);
-
-        QTreeWidgetItem *item = new QTreeWidgetItem(treeWidget);
-        item->setText(0, name);
-        item->setText(1, typeStr);
-        item->setText(2, details);
-        item->setText(3, sizeStr);
-        item->setCheckState(0, Qt::Unchecked); 
-    }
-}
-
-QString EnvironmentPane::formatSize(double bytes)
-{
-    if (bytes < 1024) {
-        return QString::number(bytes) + " B";
-    } else if (bytes < 1024 * 1024) {
-        return QString::number(bytes / 1024.0, 'f', 2) + " KB";
-    } else if (bytes < 1024 * 1024 * 1024) {
-        return QString::number(bytes / (1024.0 * 1024.0), 'f', 2) + " MB";
-    } else {
-        return QString::number(bytes / (1024.0 * 1024.0 * 1024.0), 'f', 2) + " GB";
+        memoryLabel->setText("Used memory: " + EnvironmentModel::formatSize(totalSize));
     }
 }
@@ -2,18 +2,20 @@
 #define ENVIRONMENTPANE_H
 
 #include <QWidget>
-#include <QTreeWidget>
+#include <QTreeView>
+#include <QLineEdit>
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QLabel>
-
-#include <QFileSystemWatcher>
+#include <QSet>
 
 class TerminalWidget;
+class EnvironmentModel;
+class QSortFilterProxyModel;
+struct EnvironmentSnapshot;
+struct EnvironmentDelta;
+struct EvalResult;
 
 class EnvironmentPane : public QWidget
 {
@@ -23,30 +25,44 @@ public:
     explicit EnvironmentPane(TerminalWidget *terminal, QWidget *parent = nullptr);
     ~EnvironmentPane();
 
+    // Names of the top-level objects ticked in the pane
+    QStringList checkedNames() const;
+
 public slots:
     void refreshEnvironment();
     void deleteCheckedItems();
 
+signals:
+    // Open a data viewer on the object R resolves path to
+    void viewRequested(const QStringList &path, const QString &title);
+
 private slots:
-    void onEnvironmentFileChanged(const QString &path);
+    void showEnvironment(const EnvironmentSnapshot &snapshot);
+    void applyEnvironmentDelta(const EnvironmentDelta &delta);
     void clearAllItems();
     void runGC();
+    void fetchVisibleChildren();
+    void showEvalResult(const EvalResult &result);
+    void showContextMenu(const QPoint &pos);
 
 private:
     TerminalWidget *terminal;
-    QTreeWidget *treeWidget;
+    QTreeView *treeView;
+    QLineEdit *filterEdit;
+    EnvironmentModel *model;
+    QSortFilterProxyModel *proxy;
     QPushButton *refreshButton;
     QPushButton *deleteButton;
     QPushButton *clearButton;
     QPushButton *gcButton;
     QLabel *memoryLabel;
-    
-    QString envFilePath;
-    QFileSystemWatcher *fileWatcher;
+    // Requests this pane evaluated out of band; errors are shown
+    QSet<quint32> evalRequests;
 
-    void parseEnvironmentData(const QByteArray &jsonData);
-    void setupEnvironmentMonitor();
-    QString formatSize(double bytes);
+    void updateMemoryLabel(double totalSize);
+    void requestPendingSizes();
+    void evaluate(const QString &code);
+    void viewObject(const QModelIndex &proxyIndex);
 };
 
 #endif // ENVIRONMENTPANE_H
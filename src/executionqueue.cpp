@@ -0,0 +1,65 @@
+#include "executionqueue.h"
+#include "terminalwidget.h"
+#include "sessionstate.h"
+#include <QFile>
+#include <QDebug>
+
+ExecutionQueue::ExecutionQueue(TerminalWidget *terminal, SessionState *state, QObject *parent)
+    : QObject(parent), terminal(terminal), state(state)
+{
+    // Also fires when qide disconnects, so code is never held back forever
+    connect(state, &SessionState::idle, this, [this]() {
+        if (!pending.isEmpty()) dispatch();
+    });
+}
+
+void ExecutionQueue::enqueue(const QString &code)
+{
+    pending.append(code);
+    if (state->isBusy()) {
+        emit pendingChanged(pending.size());
+        return;
+    }
+    dispatch();
+}
+
+void ExecutionQueue::clear()
+{
+    if (pending.isEmpty()) return;
+    pending.clear();
+    emit pendingChanged(0);
+}
+
+void ExecutionQueue::dispatch()
+{
+    // Everything queued while R was busy goes out as one chunk
+    const QString code = pending.join('\n');
+    pending.clear();
+    emit pendingChanged(0);
+
+    // executeCommand() marks the session busy until this chunk is done
+    const bool large = code.size() > SourceThresholdBytes
+        || code.count('\n') >= SourceThresholdLines;
+    terminal->executeCommand(large ? sourceCommand(code) : code);
+}
+
+QString ExecutionQueue::sourceCommand(const QString &code)
+{
+    // One file per chunk: without qide nothing holds the next chunk back
+    // until R has parsed the previous one. R removes the file once it has
+    // run it, errors included.
+    if (tempDir.isValid()) {
+        QFile file(tempDir.filePath(QString("run-%1.R").arg(++chunkCounter)));
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(code.toUtf8());
+            file.close();
+
+            QString path = file.fileName();
+            path.replace('\\', '/').replace('\'', "\\'");
+            return QString("local({ f <- '%1'; on.exit(unlink(f)); "
+                           "source(f, echo = TRUE, max.deparse.length = Inf, encoding = 'UTF-8') })").arg(path);
+        }
+        qWarning() << "Cannot write" << file.fileName() << ":" << file.errorString();
+    }
+    return code;
+}
@@ -0,0 +1,48 @@
+#ifndef EXECUTIONQUEUE_H
+#define EXECUTIONQUEUE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTemporaryDir>
+
+class TerminalWidget;
+class SessionState;
+
+// Code waiting to run in one R console. Chunks sent while R is busy are
+// held back and dispatched together once SessionState reports R idle at
+// the prompt. Large chunks are not typed into the terminal line by line:
+// each is written to its own file in a per-session temporary directory
+// and run with a single source() call, which deletes the file after.
+class ExecutionQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Chunks above either limit are sourced from a file. R's console
+    // reads at most 4096 bytes per line, so larger code would not even
+    // survive being typed.
+    static constexpr int SourceThresholdBytes = 2048;
+    static constexpr int SourceThresholdLines = 20;
+
+    ExecutionQueue(TerminalWidget *terminal, SessionState *state, QObject *parent = nullptr);
+
+    void enqueue(const QString &code);
+    int pendingCount() const { return pending.size(); }
+    // Drops code that has not been dispatched yet
+    void clear();
+
+signals:
+    void pendingChanged(int chunks);
+
+private:
+    void dispatch();
+    QString sourceCommand(const QString &code);
+
+    TerminalWidget *terminal;
+    SessionState *state;
+    QStringList pending;
+    QTemporaryDir tempDir;
+    int chunkCounter = 0;
+};
+
+#endif // EXECUTIONQUEUE_H
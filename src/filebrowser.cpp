@@ -38,6 +38,8 @@ FileBrowser::FileBrowser(QWidget *parent)
     treeView->setSortingEnabled(true);
     treeView->sortByColumn(0, Qt::AscendingOrder);
     treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+    // Several scripts can be picked for a batch run
+    treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
     
     // Show columns for sorting options
     treeView->setColumnWidth(0, 200);
@@ -129,6 +131,22 @@ void FileBrowser::showContextMenu(const QPoint &pos)
         connect(pasteAct, &QAction::triggered, this, &FileBrowser::pasteFile);
     }
     
+    // Background jobs for R scripts
+    const QStringList scripts = selectedScripts();
+    if (!scripts.isEmpty()) {
+        contextMenu.addSeparator();
+        QAction *batchAct = contextMenu.addAction(tr("Run as Batch (%n script(s))", "", scripts.size()));
+        connect(batchAct, &QAction::triggered, this, [this, scripts]() {
+            emit runBatchRequested(scripts);
+        });
+        if (scripts.size() == 1) {
+            QAction *gridAct = contextMenu.addAction(tr("Run with Parameter Grid..."));
+            connect(gridAct, &QAction::triggered, this, [this, scripts]() {
+                emit runGridRequested(scripts.first());
+            });
+        }
+    }
+    
     contextMenu.addSeparator();
     
     // Sort submenu
@@ -141,6 +159,18 @@ void FileBrowser::showContextMenu(const QPoint &pos)
     contextMenu.exec(treeView->viewport()->mapToGlobal(pos));
 }
 
+QStringList FileBrowser::selectedScripts() const
+{
+    QStringList scripts;
+    for (const QModelIndex &index : treeView->selectionModel()->selectedRows()) {
+        const QFileInfo info = model->fileInfo(index);
+        if (info.isFile() && info.suffix().compare("r", Qt::CaseInsensitive) == 0) {
+            scripts << info.absoluteFilePath();
+        }
+    }
+    return scripts;
+}
+
 void FileBrowser::renameFile()
 {
     QModelIndex index = treeView->currentIndex();
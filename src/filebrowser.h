@@ -17,6 +17,10 @@ public:
 
 signals:
     void fileDoubleClicked(const QString &filePath);
+    // Run the selected R scripts as a batch of background jobs
+    void runBatchRequested(const QStringList &scripts);
+    // Run one R script over a parameter grid
+    void runGridRequested(const QString &script);
 
 private slots:
     void onItemDoubleClicked(const QModelIndex &index);
@@ -32,6 +36,8 @@ private slots:
     void sortByDate();
 
 private:
+    QStringList selectedScripts() const;
+
     QTreeView *treeView;
     QFileSystemModel *model;
     QLineEdit *filterEdit;
@@ -0,0 +1,112 @@
+#include "fileloader.h"
+#include <QThread>
+
+namespace {
+// Large enough to keep the disk busy, small enough that appending one
+// chunk to the editor never blocks the GUI noticeably
+constexpr qint64 ChunkSize = 512 * 1024;
+
+// Bytes at the end of data that start a UTF-8 sequence but do not
+// complete it; empty if the data ends on a character boundary
+QByteArray incompleteSequence(const QByteArray &data)
+{
+    for (qsizetype i = data.size() - 1; i >= 0 && i >= data.size() - 3; --i) {
+        const uchar c = uchar(data.at(i));
+        if ((c & 0xc0) == 0x80) continue;  // continuation byte
+        const qsizetype length = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        return data.size() - i < length ? data.mid(i) : QByteArray();
+    }
+    return QByteArray();
+}
+}
+
+FileReader::FileReader(const QString &path, QObject *parent)
+    : QObject(parent)
+    , file(path)
+    , decoder(QStringDecoder::Utf8)
+{
+}
+
+void FileReader::open()
+{
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        emit failed(file.errorString());
+        return;
+    }
+    totalBytes = file.size();
+    readChunk();
+}
+
+void FileReader::readChunk()
+{
+    if (!file.isOpen()) return;
+
+    const QByteArray data = file.read(ChunkSize);
+    if (data.isEmpty()) {
+        file.close();
+        // The decoder holds back a sequence the file cut short, waiting
+        // for bytes that never come; show it the way readAll() would
+        const QByteArray incomplete = incompleteSequence(tail);
+        bool invalid = decoder.hasError();
+        if (!incomplete.isEmpty()) {
+            emit chunkRead(QString::fromUtf8(incomplete), file.size(), totalBytes);
+            invalid = true;
+        }
+        if (invalid) emit invalidText();
+        emit finished();
+        return;
+    }
+
+    tail = (tail + data).right(3);
+    const QString text = decoder.decode(data);
+    emit chunkRead(text, file.pos(), totalBytes);
+}
+
+FileLoader::FileLoader(const QString &path, QObject *parent)
+    : QObject(parent)
+    , path(path)
+    , workerThread(new QThread)
+    , reader(new FileReader(path))
+{
+    reader->moveToThread(workerThread);
+
+    connect(reader, &FileReader::chunkRead, this, &FileLoader::onChunkRead);
+    connect(reader, &FileReader::invalidText, this, [this]() {
+        if (!cancelled) emit invalidText();
+    });
+    connect(reader, &FileReader::finished, this, [this]() {
+        if (!cancelled) emit finished();
+    });
+    connect(reader, &FileReader::failed, this, [this](const QString &error) {
+        if (!cancelled) emit failed(error);
+    });
+}
+
+FileLoader::~FileLoader()
+{
+    workerThread->quit();
+    workerThread->wait();
+    delete reader;
+    delete workerThread;
+}
+
+void FileLoader::start()
+{
+    workerThread->start();
+    QMetaObject::invokeMethod(reader, &FileReader::open, Qt::QueuedConnection);
+}
+
+void FileLoader::cancel()
+{
+    cancelled = true;
+    workerThread->quit();
+}
+
+void FileLoader::onChunkRead(const QString &text, qint64 bytesRead, qint64 totalBytes)
+{
+    if (cancelled) return;
+
+    // Read ahead while the consumer appends this chunk
+    QMetaObject::invokeMethod(reader, &FileReader::readChunk, Qt::QueuedConnection);
+    emit chunkLoaded(text, bytesRead, totalBytes);
+}
@@ -0,0 +1,69 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QFile>
+#include <QStringDecoder>
+
+class QThread;
+
+// Reads a file in fixed-size chunks on a worker thread, decoding UTF-8
+// incrementally so multi-byte sequences split across chunks survive.
+class FileReader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileReader(const QString &path, QObject *parent = nullptr);
+
+public slots:
+    void open();
+    void readChunk();
+
+signals:
+    void chunkRead(const QString &text, qint64 bytesRead, qint64 totalBytes);
+    // The file is not valid UTF-8; bad bytes were read as U+FFFD
+    void invalidText();
+    void finished();
+    void failed(const QString &error);
+
+private:
+    QFile file;
+    QStringDecoder decoder;
+    qint64 totalBytes = 0;
+    // Last bytes read, to find a sequence cut off by the end of the file
+    QByteArray tail;
+};
+
+// GUI-side handle for an asynchronous load. Chunks are delivered through
+// chunkLoaded() on the GUI thread; the next chunk is read while the
+// current one is being consumed, so at most one chunk is ever queued.
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(const QString &path, QObject *parent = nullptr);
+    ~FileLoader();
+
+    void start();
+    void cancel();
+    QString filePath() const { return path; }
+
+signals:
+    void chunkLoaded(const QString &text, qint64 bytesRead, qint64 totalBytes);
+    void invalidText();
+    void finished();
+    void failed(const QString &error);
+
+private slots:
+    void onChunkRead(const QString &text, qint64 bytesRead, qint64 totalBytes);
+
+private:
+    QString path;
+    QThread *workerThread;
+    FileReader *reader;
+    bool cancelled = false;
+};
+
+#endif // FILELOADER_H
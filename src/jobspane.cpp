@@ -0,0 +1,634 @@
+#include "jobspane.h"
+#include "environmentmodel.h"
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFile>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSettings>
+#include <QSplitter>
+#include <QTableWidget>
+#include <QTextCursor>
+#include <QThread>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <algorithm>
+
+namespace {
+
+// More combinations than this is almost certainly a typo in the grid
+const int MaxGridTasks = 10000;
+
+QString formatElapsed(qint64 ms)
+{
+    const qint64 seconds = ms / 1000;
+    return QString("%1:%2:%3")
+        .arg(seconds / 3600)
+        .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+        .arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+// Summary table cell shown formatted but sorted by the number stored in
+// Qt::UserRole, so 10:00:00 sorts after 2:00:00 and 1.2 GB after 900 MB
+class NumberItem : public QTableWidgetItem
+{
+public:
+    NumberItem(const QString &text, double value)
+        : QTableWidgetItem(text)
+    {
+        setData(Qt::UserRole, value);
+    }
+
+    bool operator<(const QTableWidgetItem &other) const override
+    {
+        return data(Qt::UserRole).toDouble() < other.data(Qt::UserRole).toDouble();
+    }
+};
+
+// Splits R expressions at commas outside brackets and strings, so values
+// like c(1, 2) or "a, b" stay whole
+QStringList splitValues(const QString &text)
+{
+    QStringList values;
+    QString current;
+    int depth = 0;
+    QChar quote;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (!quote.isNull()) {
+            if (c == '\\' && i + 1 < text.size()) {
+                current += c;
+                current += text.at(++i);
+                continue;
+            }
+            if (c == quote) quote = QChar();
+        } else if (c == '"' || c == '\'' || c == '`') {
+            quote = c;
+        } else if (c == '(' || c == '[' || c == '{') {
+            ++depth;
+        } else if (c == ')' || c == ']' || c == '}') {
+            --depth;
+        } else if (c == ',' && depth == 0) {
+            values << current.trimmed();
+            current.clear();
+            continue;
+        }
+        current += c;
+    }
+    values << current.trimmed();
+    return values;
+}
+
+// Every combination of the grid's values, the first parameter varying
+// slowest. Lines are "name = value1, value2, ...".
+bool expandGrid(const QString &text, QList<ScriptJob::Parameters> &combinations, QString &error)
+{
+    static const QRegularExpression namePattern("^([A-Za-z.][A-Za-z0-9._]*)\\s*=(.*)$");
+
+    combinations = {ScriptJob::Parameters()};
+    for (const QString &rawLine : text.split('\n')) {
+        const QString line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+
+        const QRegularExpressionMatch match = namePattern.match(line);
+        if (!match.hasMatch()) {
+            error = QObject::tr("Expected \"name = value1, value2, ...\": %1").arg(line);
+            return false;
+        }
+        const QStringList values = splitValues(match.captured(2));
+        if (values.contains(QString())) {
+            error = QObject::tr("Empty value for %1").arg(match.captured(1));
+            return false;
+        }
+        if (qint64(combinations.size()) * values.size() > MaxGridTasks) {
+            error = QObject::tr("The grid has more than %1 combinations").arg(MaxGridTasks);
+            return false;
+        }
+
+        QList<ScriptJob::Parameters> expanded;
+        for (const ScriptJob::Parameters &combination : combinations) {
+            for (const QString &value : values) {
+                ScriptJob::Parameters parameters = combination;
+                parameters.append({match.captured(1), value});
+                expanded.append(parameters);
+            }
+        }
+        combinations = expanded;
+    }
+    if (combinations.first().isEmpty()) {
+        error = QObject::tr("The grid has no parameters");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+JobsPane::JobsPane(QWidget *parent)
+    : QWidget(parent)
+{
+    QSettings settings("Q", "Q");
+    workers = qMax(1, settings.value("jobs/workers", QThread::idealThreadCount()).toInt());
+    retries = qBound(0, settings.value("jobs/retries", 1).toInt(), 10);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    QHBoxLayout *toolLayout = new QHBoxLayout();
+    stopButton = new QPushButton(tr("Stop"), this);
+    retryButton = new QPushButton(tr("Retry Failed"), this);
+    importButton = new QPushButton(tr("Import Results"), this);
+    removeButton = new QPushButton(tr("Remove"), this);
+    toolLayout->addWidget(stopButton);
+    toolLayout->addWidget(retryButton);
+    toolLayout->addWidget(importButton);
+    toolLayout->addWidget(removeButton);
+    toolLayout->addStretch();
+    layout->addLayout(toolLayout);
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+
+    jobList = new QTreeWidget(splitter);
+    jobList->setColumnCount(ColumnCount);
+    jobList->setHeaderLabels({tr("Script"), tr("Status"), tr("Progress"), tr("Elapsed"), tr("Peak Memory")});
+    jobList->setUniformRowHeights(true);
+    jobList->header()->setSectionResizeMode(ScriptColumn, QHeaderView::Stretch);
+    jobList->header()->setStretchLastSection(false);
+
+    outputView = new QPlainTextEdit(splitter);
+    outputView->setReadOnly(true);
+    outputView->setLineWrapMode(QPlainTextEdit::NoWrap);
+    outputView->setFont(QFont("Monospace"));
+    outputView->setPlaceholderText(tr("Output of the selected job"));
+
+    splitter->addWidget(jobList);
+    splitter->addWidget(outputView);
+    layout->addWidget(splitter);
+
+    // Elapsed times of running jobs tick without any event from them
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, this, &JobsPane::refreshRunningJobs);
+
+    connect(jobList, &QTreeWidget::currentItemChanged, this, &JobsPane::showSelectedJob);
+    connect(stopButton, &QPushButton::clicked, this, &JobsPane::stopSelected);
+    connect(retryButton, &QPushButton::clicked, this, &JobsPane::retrySelected);
+    connect(importButton, &QPushButton::clicked, this, &JobsPane::importSelectedJob);
+    connect(removeButton, &QPushButton::clicked, this, &JobsPane::removeSelected);
+    updateButtons();
+}
+
+JobsPane::~JobsPane()
+{
+    // Jobs kill their processes; do it before the temporary directory
+    // holding their files goes away
+    for (Task *task : tasks) {
+        delete task->job;
+    }
+    qDeleteAll(tasks);
+    qDeleteAll(batches);
+}
+
+void JobsPane::runScript(const QString &script)
+{
+    Task *task = addTask(script, ScriptJob::Parameters(), nullptr);
+    jobList->setCurrentItem(task->item);
+}
+
+void JobsPane::runBatch(const QStringList &scripts)
+{
+    if (scripts.isEmpty()) return;
+
+    Batch *batch = addBatch(tr("Batch %1 (%n script(s))", "", scripts.size()).arg(nextBatchId), scripts.size());
+    for (const QString &script : scripts) {
+        addTask(script, ScriptJob::Parameters(), batch);
+    }
+    jobList->setCurrentItem(batch->item);
+}
+
+void JobsPane::runGrid(const QString &script)
+{
+    bool ok = false;
+    const QString grid = QInputDialog::getMultiLineText(this, tr("Run with Parameter Grid"),
+        tr("One parameter per line, as name = value1, value2, ...\n"
+           "Values are R expressions; %1 runs once per combination.").arg(QFileInfo(script).fileName()),
+        QString(), &ok);
+    if (!ok || grid.trimmed().isEmpty()) return;
+
+    QList<ScriptJob::Parameters> combinations;
+    QString error;
+    if (!expandGrid(grid, combinations, error)) {
+        QMessageBox::warning(this, tr("Run with Parameter Grid"), error);
+        return;
+    }
+
+    Batch *batch = addBatch(tr("Batch %1: %2 (%n combination(s))", "", combinations.size())
+                                .arg(nextBatchId).arg(QFileInfo(script).fileName()),
+                            combinations.size());
+    for (const ScriptJob::Parameters &parameters : combinations) {
+        addTask(script, parameters, batch);
+    }
+    jobList->setCurrentItem(batch->item);
+}
+
+JobsPane::Batch *JobsPane::addBatch(const QString &title, int size)
+{
+    Batch *batch = new Batch;
+    batch->id = nextBatchId++;
+    batch->size = size;
+    batch->item = new QTreeWidgetItem(jobList);
+    batch->item->setText(ScriptColumn, title);
+    batch->item->setExpanded(true);
+    batch->timer.start();
+    batches.append(batch);
+    batchItems.insert(batch->item, batch);
+    return batch;
+}
+
+JobsPane::Task *JobsPane::addTask(const QString &script, const ScriptJob::Parameters &parameters, Batch *batch)
+{
+    Task *task = new Task;
+    task->batch = batch;
+    task->script = QFileInfo(script).absoluteFilePath();
+    task->parameters = parameters;
+    task->label = QFileInfo(script).fileName();
+    if (!parameters.isEmpty()) {
+        QStringList assignments;
+        for (const auto &parameter : parameters) {
+            assignments << parameter.first + " = " + parameter.second;
+        }
+        task->label += " [" + assignments.join(", ") + "]";
+    }
+
+    task->item = batch ? new QTreeWidgetItem(batch->item) : new QTreeWidgetItem(jobList);
+    task->item->setText(ScriptColumn, task->label);
+    task->item->setToolTip(ScriptColumn, task->script);
+    tasks.append(task);
+    taskItems.insert(task->item, task);
+
+    startAttempt(task);
+    return task;
+}
+
+void JobsPane::startAttempt(Task *task)
+{
+    if (task->job) {
+        disconnect(task->job, nullptr, this, nullptr);
+        QFile::remove(task->job->resultFile());
+        // This may run from the job's own finished() signal
+        task->job->deleteLater();
+    }
+    ++task->attempts;
+
+    const QFileInfo info(task->script);
+    ScriptJob *job = new ScriptJob(nextJobId++, task->script, info.absolutePath(),
+                                   tempDir.path(), task->parameters, this);
+    task->job = job;
+
+    connect(job, &ScriptJob::changed, this, [this, task]() {
+        updateItem(task);
+    });
+    connect(job, &ScriptJob::outputAdded, this, [this, task](const QString &text) {
+        if (selectedTask() != task) return;
+        // Follow the output only when already at the bottom
+        QScrollBar *bar = outputView->verticalScrollBar();
+        const bool atEnd = bar->value() == bar->maximum();
+        QTextCursor cursor(outputView->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(text);
+        if (atEnd) {
+            bar->setValue(bar->maximum());
+        }
+    });
+    connect(job, &ScriptJob::finished, this, [this, task]() {
+        onJobFinished(task);
+    });
+
+    updateItem(task);
+    if (selectedTask() == task) {
+        showSelectedJob();
+    }
+    // Queued, so a job finishing inside schedule() cannot re-enter it
+    QTimer::singleShot(0, this, &JobsPane::schedule);
+}
+
+void JobsPane::schedule()
+{
+    int running = 0;
+    for (const Task *task : tasks) {
+        if (task->job->status() == ScriptJob::Running) ++running;
+    }
+    for (Task *task : tasks) {
+        if (running >= workers) break;
+        if (task->job->status() == ScriptJob::Queued) {
+            task->job->start();
+            ++running;
+        }
+    }
+    if (running > 0) {
+        refreshTimer->start();
+    }
+}
+
+void JobsPane::onJobFinished(Task *task)
+{
+    // Flaky batch tasks (a full disk, a killed worker) get another go
+    if (task->batch && task->job->status() == ScriptJob::Failed && task->attempts <= retries) {
+        startAttempt(task);
+        return;
+    }
+
+    updateItem(task);
+    if (Batch *batch = task->batch) {
+        updateBatchItem(batch);
+        const QList<Task*> batchTasks = tasksOf(batch);
+        if (std::all_of(batchTasks.begin(), batchTasks.end(), &JobsPane::isFinished)) {
+            batch->wallTime = batch->earlierRuns + batch->timer.elapsed();
+            updateBatchItem(batch);
+            showBatchSummary(batch);
+        }
+    }
+    updateButtons();
+    QTimer::singleShot(0, this, &JobsPane::schedule);
+}
+
+bool JobsPane::isFinished(const Task *task)
+{
+    const ScriptJob::Status status = task->job->status();
+    return status == ScriptJob::Succeeded || status == ScriptJob::Failed || status == ScriptJob::Stopped;
+}
+
+QList<JobsPane::Task*> JobsPane::tasksOf(Batch *batch) const
+{
+    QList<Task*> result;
+    for (Task *task : tasks) {
+        if (task->batch == batch) result.append(task);
+    }
+    return result;
+}
+
+JobsPane::Task *JobsPane::selectedTask() const
+{
+    return taskItems.value(jobList->currentItem(), nullptr);
+}
+
+JobsPane::Batch *JobsPane::selectedBatch() const
+{
+    return batchItems.value(jobList->currentItem(), nullptr);
+}
+
+void JobsPane::updateItem(Task *task)
+{
+    const ScriptJob *job = task->job;
+    QTreeWidgetItem *item = task->item;
+
+    QString status = ScriptJob::statusText(job->status());
+    if (task->attempts > 1) {
+        status = tr("%1 (attempt %2)").arg(status).arg(task->attempts);
+    }
+    item->setText(StatusColumn, status);
+    if (job->steps() > 0) {
+        item->setText(ProgressColumn, QString("%1%").arg(job->progress() * 100 / job->steps()));
+        item->setToolTip(ProgressColumn, tr("%1 of %2 expressions").arg(job->progress()).arg(job->steps()));
+    } else {
+        item->setText(ProgressColumn, QString());
+    }
+    item->setText(ElapsedColumn, formatElapsed(job->elapsed()));
+    item->setText(MemoryColumn, job->peakMemory() > 0
+        ? EnvironmentModel::formatSize(double(job->peakMemory())) : QString());
+    if (item == jobList->currentItem()) {
+        updateButtons();
+    }
+}
+
+void JobsPane::updateBatchItem(Batch *batch)
+{
+    int finished = 0;
+    int failed = 0;
+    qint64 peak = 0;
+    for (const Task *task : tasksOf(batch)) {
+        if (isFinished(task)) ++finished;
+        if (task->job->status() == ScriptJob::Failed) ++failed;
+        peak = qMax(peak, task->job->peakMemory());
+    }
+
+    QString status = tr("%1 of %2 finished").arg(finished).arg(batch->size);
+    if (failed > 0) {
+        status += tr(", %n failed", "", failed);
+    }
+    batch->item->setText(StatusColumn, status);
+    batch->item->setText(ProgressColumn, QString("%1%").arg(batch->size > 0 ? finished * 100 / batch->size : 100));
+    const qint64 wallTime = batch->wallTime >= 0 ? batch->wallTime : batch->earlierRuns + batch->timer.elapsed();
+    batch->item->setText(ElapsedColumn, formatElapsed(wallTime));
+    batch->item->setText(MemoryColumn, peak > 0 ? EnvironmentModel::formatSize(double(peak)) : QString());
+    if (batch->item == jobList->currentItem()) {
+        updateButtons();
+    }
+}
+
+void JobsPane::showBatchSummary(Batch *batch)
+{
+    const QList<Task*> batchTasks = tasksOf(batch);
+    int succeeded = 0;
+    int failed = 0;
+    int stopped = 0;
+    qint64 taskTime = 0;
+
+    QDialog *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle(tr("Batch %1 Summary").arg(batch->id));
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+
+    QLabel *summary = new QLabel(dialog);
+    summary->setWordWrap(true);
+    layout->addWidget(summary);
+
+    QTableWidget *table = new QTableWidget(batchTasks.size(), 5, dialog);
+    table->setHorizontalHeaderLabels({tr("Task"), tr("Status"), tr("Attempts"), tr("Duration"), tr("Peak Memory")});
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    for (int row = 0; row < batchTasks.size(); ++row) {
+        const Task *task = batchTasks.at(row);
+        const ScriptJob *job = task->job;
+        switch (job->status()) {
+        case ScriptJob::Succeeded: ++succeeded; break;
+        case ScriptJob::Failed: ++failed; break;
+        default: ++stopped; break;
+        }
+        taskTime += job->elapsed();
+
+        // Numbers sort as numbers, shown formatted
+        QTableWidgetItem *attempts = new QTableWidgetItem;
+        attempts->setData(Qt::DisplayRole, task->attempts);
+        QTableWidgetItem *duration = new NumberItem(formatElapsed(job->elapsed()), double(job->elapsed()));
+        QTableWidgetItem *memory = new NumberItem(job->peakMemory() > 0
+            ? EnvironmentModel::formatSize(double(job->peakMemory())) : QString(), double(job->peakMemory()));
+
+        table->setItem(row, 0, new QTableWidgetItem(task->label));
+        table->setItem(row, 1, new QTableWidgetItem(ScriptJob::statusText(job->status())));
+        table->setItem(row, 2, attempts);
+        table->setItem(row, 3, duration);
+        table->setItem(row, 4, memory);
+    }
+    table->setSortingEnabled(true);
+    layout->addWidget(table);
+
+    // Summed task time over wall time is how many cores the batch kept busy
+    const double speedup = batch->wallTime > 0 ? double(taskTime) / double(batch->wallTime) : 0;
+    summary->setText(tr("%1 succeeded, %2 failed, %3 stopped. Wall time %4, total task time %5 "
+                        "(%6x parallel, %7 workers).")
+        .arg(succeeded).arg(failed).arg(stopped)
+        .arg(formatElapsed(batch->wallTime), formatElapsed(taskTime))
+        .arg(speedup, 0, 'f', 1)
+        .arg(workers));
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, dialog);
+    connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::close);
+    layout->addWidget(buttons);
+
+    dialog->resize(700, 400);
+    dialog->show();
+}
+
+void JobsPane::updateButtons()
+{
+    bool canStop = false;
+    bool canRetry = false;
+    bool canRemove = false;
+    bool canImport = false;
+
+    if (const Task *task = selectedTask()) {
+        const ScriptJob::Status status = task->job->status();
+        canStop = !isFinished(task);
+        canRetry = status == ScriptJob::Failed || status == ScriptJob::Stopped;
+        // Batch tasks go with their batch
+        canRemove = isFinished(task) && !task->batch;
+        canImport = status == ScriptJob::Succeeded;
+    } else if (Batch *batch = selectedBatch()) {
+        canRemove = true;
+        for (const Task *task : tasksOf(batch)) {
+            const bool finished = isFinished(task);
+            canStop = canStop || !finished;
+            canRemove = canRemove && finished;
+            canRetry = canRetry || (finished && task->job->status() != ScriptJob::Succeeded);
+        }
+    }
+    stopButton->setEnabled(canStop);
+    retryButton->setEnabled(canRetry);
+    importButton->setEnabled(canImport);
+    removeButton->setEnabled(canRemove);
+}
+
+void JobsPane::showSelectedJob()
+{
+    const Task *task = selectedTask();
+    outputView->setPlainText(task ? task->job->output() : QString());
+    outputView->verticalScrollBar()->setValue(outputView->verticalScrollBar()->maximum());
+    updateButtons();
+}
+
+void JobsPane::stopSelected()
+{
+    if (Task *task = selectedTask()) {
+        task->job->stop();
+    } else if (Batch *batch = selectedBatch()) {
+        // Cancel the queued tasks first, or stopping a running one would
+        // start the next
+        const QList<Task*> batchTasks = tasksOf(batch);
+        for (Task *task : batchTasks) {
+            if (task->job->status() == ScriptJob::Queued) task->job->stop();
+        }
+        for (Task *task : batchTasks) {
+            task->job->stop();
+        }
+    }
+}
+
+void JobsPane::retrySelected()
+{
+    QList<Task*> retry;
+    if (Task *task = selectedTask()) {
+        retry << task;
+    } else if (Batch *batch = selectedBatch()) {
+        retry = tasksOf(batch);
+    }
+    for (Task *task : retry) {
+        const ScriptJob::Status status = task->job->status();
+        if (status == ScriptJob::Failed || status == ScriptJob::Stopped) {
+            Batch *batch = task->batch;
+            if (batch && batch->wallTime >= 0) {
+                batch->earlierRuns = batch->wallTime;
+                batch->wallTime = -1;
+                batch->timer.start();
+            }
+            startAttempt(task);
+        }
+    }
+    updateButtons();
+}
+
+void JobsPane::importSelectedJob()
+{
+    const Task *task = selectedTask();
+    if (task && task->job->status() == ScriptJob::Succeeded) {
+        emit importRequested(task->job->resultFile());
+    }
+}
+
+void JobsPane::removeSelected()
+{
+    if (Task *task = selectedTask()) {
+        if (!task->batch && isFinished(task)) {
+            removeTask(task);
+        }
+    } else if (Batch *batch = selectedBatch()) {
+        const QList<Task*> batchTasks = tasksOf(batch);
+        if (!std::all_of(batchTasks.begin(), batchTasks.end(), &JobsPane::isFinished)) return;
+        for (Task *task : batchTasks) {
+            removeTask(task);
+        }
+        batchItems.remove(batch->item);
+        batches.removeOne(batch);
+        delete batch->item;
+        delete batch;
+    }
+    showSelectedJob();
+}
+
+void JobsPane::removeTask(Task *task)
+{
+    taskItems.remove(task->item);
+    tasks.removeOne(task);
+    QFile::remove(task->job->resultFile());
+    delete task->job;
+    delete task->item;
+    delete task;
+}
+
+void JobsPane::refreshRunningJobs()
+{
+    bool running = false;
+    for (Task *task : tasks) {
+        if (task->job->status() == ScriptJob::Running) {
+            updateItem(task);
+            running = true;
+        }
+    }
+    for (Batch *batch : batches) {
+        if (batch->wallTime < 0) updateBatchItem(batch);
+    }
+    if (!running) {
+        refreshTimer->stop();
+    }
+}
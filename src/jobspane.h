@@ -0,0 +1,119 @@
+#ifndef JOBSPANE_H
+#define JOBSPANE_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QTemporaryDir>
+#include "scriptjob.h"
+
+class QPlainTextEdit;
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Scripts running as background jobs, each in its own Rscript process,
+// with their status, progress, elapsed time and peak memory, and the
+// output of the selected job.
+//
+// Jobs wait in a queue and at most jobs/workers of them (one per core by
+// default) run at once. A batch is a set of tasks listed under one item:
+// several scripts, or one script over a parameter grid. Failed batch
+// tasks are retried up to jobs/retries times, and a summary is shown once
+// the whole batch is done.
+class JobsPane : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit JobsPane(QWidget *parent = nullptr);
+    ~JobsPane();
+
+public slots:
+    // Runs script with its own directory as the working directory
+    void runScript(const QString &script);
+    void runBatch(const QStringList &scripts);
+    // Asks for a parameter grid and runs script once per combination
+    void runGrid(const QString &script);
+
+signals:
+    // Load the objects saved in file into the active R session
+    void importRequested(const QString &file);
+
+private slots:
+    void showSelectedJob();
+    void stopSelected();
+    void retrySelected();
+    void importSelectedJob();
+    void removeSelected();
+    void refreshRunningJobs();
+    void schedule();
+
+private:
+    enum Column {
+        ScriptColumn,
+        StatusColumn,
+        ProgressColumn,
+        ElapsedColumn,
+        MemoryColumn,
+        ColumnCount
+    };
+
+    struct Batch {
+        int id = 0;
+        int size = 0;
+        QTreeWidgetItem *item = nullptr;
+        // Runs over the current run only; retries after the batch finished
+        // start a new run, and wall time adds up the runs
+        QElapsedTimer timer;
+        qint64 earlierRuns = 0;
+        qint64 wallTime = -1;
+    };
+
+    // One script run, possibly over several attempts; job is the latest
+    struct Task {
+        Batch *batch = nullptr;
+        QString label;
+        QString script;
+        ScriptJob::Parameters parameters;
+        int attempts = 0;
+        ScriptJob *job = nullptr;
+        QTreeWidgetItem *item = nullptr;
+    };
+
+    Task *addTask(const QString &script, const ScriptJob::Parameters &parameters, Batch *batch);
+    Batch *addBatch(const QString &title, int size);
+    void startAttempt(Task *task);
+    void onJobFinished(Task *task);
+    void updateItem(Task *task);
+    void updateBatchItem(Batch *batch);
+    void showBatchSummary(Batch *batch);
+    void removeTask(Task *task);
+    void updateButtons();
+    Task *selectedTask() const;
+    Batch *selectedBatch() const;
+    QList<Task*> tasksOf(Batch *batch) const;
+    static bool isFinished(const Task *task);
+
+    QTreeWidget *jobList;
+    QPlainTextEdit *outputView;
+    QPushButton *stopButton;
+    QPushButton *retryButton;
+    QPushButton *importButton;
+    QPushButton *removeButton;
+    QTimer *refreshTimer;
+    // In submission order, which is the order queued jobs start in
+    QList<Task*> tasks;
+    QList<Batch*> batches;
+    QHash<QTreeWidgetItem*, Task*> taskItems;
+    QHash<QTreeWidgetItem*, Batch*> batchItems;
+    QTemporaryDir tempDir;
+    int workers;
+    int retries;
+    int nextJobId = 1;
+    int nextBatchId = 1;
+};
+
+#endif // JOBSPANE_H
@@ -0,0 +1,484 @@
+#include "largefileviewer.h"
+#include <QByteArrayView>
+#include <QHBoxLayout>
+#include <QInputDialog>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPainter>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QShortcut>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+// Search the mapped bytes in blocks so a cancelled search stops quickly
+constexpr qint64 SearchBlock = 16 * 1024 * 1024;
+// Publish index checkpoints to the GUI after this many bytes
+constexpr qint64 IndexPublishBytes = 64 * 1024 * 1024;
+// Never decode more than this much of a single line for display
+constexpr qint64 MaxDisplayBytes = 8192;
+
+qint64 findForward(QByteArrayView haystack, QByteArrayView needle, qint64 from, qint64 to,
+                   const std::atomic<bool> &cancel)
+{
+    qint64 pos = from;
+    while (pos < to && !cancel) {
+        const qint64 chunkEnd = qMin(to + needle.size() - 1, qMin(qint64(haystack.size()),
+                                     pos + SearchBlock + needle.size() - 1));
+        const qint64 index = haystack.first(chunkEnd).indexOf(needle, pos);
+        if (index >= 0 && index < to) return index;
+        pos += SearchBlock;
+    }
+    return -1;
+}
+
+qint64 findBackward(QByteArrayView haystack, QByteArrayView needle, qint64 from, qint64 to,
+                    const std::atomic<bool> &cancel)
+{
+    // Matches must start before `from` and at or after `to`
+    qint64 pos = from;
+    while (pos > to && !cancel) {
+        const qint64 chunkStart = qMax(to, pos - SearchBlock);
+        const qint64 chunkEnd = qMin(qint64(haystack.size()), pos - 1 + needle.size());
+        const qint64 index = haystack.sliced(chunkStart, chunkEnd - chunkStart).lastIndexOf(needle);
+        if (index >= 0) return chunkStart + index;
+        pos = chunkStart;
+    }
+    return -1;
+}
+
+QString displayText(const uchar *bytes, qint64 length)
+{
+    QString text = QString::fromUtf8(reinterpret_cast<const char *>(bytes), length);
+    if (text.endsWith(QLatin1Char('\r'))) text.chop(1);
+    text.replace(QLatin1Char('\t'), QLatin1String("    "));
+    return text;
+}
+
+} // namespace
+
+LargeFileViewer::LargeFileViewer(const QString &path, QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , file(path)
+{
+    currentTheme = ThemeManager::instance().currentTheme();
+
+    // Same font preference as CodeEditor
+    QFont font;
+    QStringList fonts = {"Hack", "Noto Sans Mono", "Courier New", "Monospace"};
+    for (const QString &fontName : fonts) {
+        font = QFont(fontName, 10);
+        if (QFontInfo(font).family() == fontName) {
+            break;
+        }
+    }
+    font.setStyleHint(QFont::TypeWriter);
+    setFont(font);
+
+    // Find bar, shown at the bottom on Ctrl+F
+    findBar = new QWidget(this);
+    QHBoxLayout *findLayout = new QHBoxLayout(findBar);
+    findLayout->setContentsMargins(4, 2, 4, 2);
+    findEdit = new QLineEdit(findBar);
+    findEdit->setPlaceholderText(tr("Find in file..."));
+    QPushButton *nextButton = new QPushButton(tr("Next"), findBar);
+    QPushButton *previousButton = new QPushButton(tr("Previous"), findBar);
+    QPushButton *closeButton = new QPushButton(tr("Close"), findBar);
+    findStatus = new QLabel(findBar);
+    findLayout->addWidget(findEdit);
+    findLayout->addWidget(nextButton);
+    findLayout->addWidget(previousButton);
+    findLayout->addWidget(findStatus, 1);
+    findLayout->addWidget(closeButton);
+    findBar->hide();
+
+    connect(findEdit, &QLineEdit::textChanged, this, [this]() {
+        // Incremental: keep the current match if it still matches
+        const qint64 from = matchOffset >= 0 ? matchOffset : lineStart(verticalScrollBar()->value());
+        startSearch(true, from);
+    });
+    connect(findEdit, &QLineEdit::returnPressed, this, &LargeFileViewer::findNext);
+    connect(nextButton, &QPushButton::clicked, this, &LargeFileViewer::findNext);
+    connect(previousButton, &QPushButton::clicked, this, &LargeFileViewer::findPrevious);
+    connect(closeButton, &QPushButton::clicked, this, [this]() {
+        findBar->hide();
+        setViewportMargins(0, 0, 0, 0);
+        viewport()->setFocus();
+    });
+
+    QShortcut *findShortcut = new QShortcut(QKeySequence::Find, this);
+    findShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(findShortcut, &QShortcut::activated, this, &LargeFileViewer::showFindBar);
+
+    QShortcut *nextShortcut = new QShortcut(QKeySequence::FindNext, this);
+    nextShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(nextShortcut, &QShortcut::activated, this, &LargeFileViewer::findNext);
+
+    QShortcut *previousShortcut = new QShortcut(QKeySequence::FindPrevious, this);
+    previousShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(previousShortcut, &QShortcut::activated, this, &LargeFileViewer::findPrevious);
+
+    QShortcut *gotoShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_G), this);
+    gotoShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(gotoShortcut, &QShortcut::activated, this, &LargeFileViewer::showGotoLineDialog);
+
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, viewport(), qOverload<>(&QWidget::update));
+    connect(horizontalScrollBar(), &QScrollBar::valueChanged, viewport(), qOverload<>(&QWidget::update));
+
+    checkpoints.append(0);
+
+    if (file.open(QIODevice::ReadOnly)) {
+        size = file.size();
+        if (size > 0) {
+            data = file.map(0, size);
+        }
+    }
+
+    if (data) {
+        startIndexing();
+    } else {
+        indexDone = true;
+    }
+    updateScrollBars();
+}
+
+LargeFileViewer::~LargeFileViewer()
+{
+    cancelled = true;
+    if (searchCancelled) {
+        *searchCancelled = true;
+    }
+    if (indexThread) {
+        indexThread->wait();
+    }
+    if (searchThread) {
+        searchThread->wait();
+    }
+    if (data) {
+        file.unmap(const_cast<uchar *>(data));
+    }
+}
+
+void LargeFileViewer::setTheme(const EditorTheme &theme)
+{
+    currentTheme = theme;
+    viewport()->update();
+}
+
+void LargeFileViewer::startIndexing()
+{
+    const uchar *base = data;
+    const qint64 total = size;
+
+    QThread *worker = QThread::create([this, base, total]() {
+        QVector<qint64> batch;
+        qint64 lines = 1;
+        qint64 longest = 0;
+        qint64 lastStart = 0;
+        qint64 lastPublished = 0;
+        const uchar *p = base;
+        const uchar *end = base + total;
+
+        while (p < end && !cancelled) {
+            const void *found = std::memchr(p, '\n', size_t(end - p));
+            if (!found) break;
+            const qint64 start = static_cast<const uchar *>(found) - base + 1;
+            longest = qMax(longest, start - lastStart);
+            lastStart = start;
+            if (lines % IndexStride == 0) {
+                batch.append(start);
+            }
+            ++lines;
+            p = base + start;
+
+            if (start - lastPublished >= IndexPublishBytes) {
+                QMetaObject::invokeMethod(this, [this, batch, lines, start, longest]() {
+                    appendIndex(batch, lines, start, longest, false);
+                }, Qt::QueuedConnection);
+                batch.clear();
+                lastPublished = start;
+            }
+        }
+
+        if (cancelled) return;
+        longest = qMax(longest, total - lastStart);
+        QMetaObject::invokeMethod(this, [this, batch, lines, total, longest]() {
+            appendIndex(batch, lines, total, longest, true);
+        }, Qt::QueuedConnection);
+    });
+
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    indexThread = worker;
+    worker->start(QThread::LowPriority);
+}
+
+void LargeFileViewer::appendIndex(const QVector<qint64> &newCheckpoints, qint64 lines,
+                                  qint64 bytesIndexed, qint64 longest, bool done)
+{
+    checkpoints += newCheckpoints;
+    knownLines = lines;
+    longestLine = longest;
+    indexDone = done;
+    updateScrollBars();
+    viewport()->update();
+
+    emit indexingProgress(bytesIndexed, size);
+    if (done) {
+        emit indexingFinished(knownLines);
+    }
+
+    // A search hit beyond the indexed range can be placed now
+    if (pendingMatch >= 0 && (done || pendingMatch < bytesIndexed)) {
+        const qint64 offset = pendingMatch;
+        pendingMatch = -1;
+        showMatch(offset);
+    }
+}
+
+qint64 LargeFileViewer::lineEnd(qint64 start) const
+{
+    if (start >= size) return size;
+    const void *found = std::memchr(data + start, '\n', size_t(size - start));
+    return found ? static_cast<const uchar *>(found) - data : size;
+}
+
+qint64 LargeFileViewer::lineStart(qint64 line) const
+{
+    line = qBound(qint64(0), line, knownLines - 1);
+    const qint64 checkpoint = qMin(line / IndexStride, qint64(checkpoints.size()) - 1);
+    qint64 offset = checkpoints[checkpoint];
+    for (qint64 i = checkpoint * IndexStride; i < line && offset < size; ++i) {
+        offset = lineEnd(offset) + 1;
+    }
+    return qMin(offset, size);
+}
+
+qint64 LargeFileViewer::lineForOffset(qint64 offset) const
+{
+    const auto it = std::upper_bound(checkpoints.cbegin(), checkpoints.cend(), offset);
+    const qint64 checkpoint = qMax(qint64(0), qint64(it - checkpoints.cbegin()) - 1);
+    qint64 line = checkpoint * IndexStride;
+    qint64 start = checkpoints[checkpoint];
+    qint64 end = lineEnd(start);
+    while (end < offset && end < size) {
+        ++line;
+        start = end + 1;
+        end = lineEnd(start);
+    }
+    return line;
+}
+
+int LargeFileViewer::gutterWidth() const
+{
+    int digits = 1;
+    qint64 max = qMax(qint64(1), knownLines);
+    while (max >= 10) {
+        max /= 10;
+        ++digits;
+    }
+    return 10 + fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits;
+}
+
+void LargeFileViewer::updateScrollBars()
+{
+    const int lineHeight = qMax(1, fontMetrics().height());
+    const int rows = qMax(1, viewport()->height() / lineHeight);
+    const qint64 maxLine = qMax(qint64(0), knownLines - rows);
+    verticalScrollBar()->setRange(0, int(qMin(maxLine, qint64(INT_MAX))));
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setSingleStep(1);
+
+    const qint64 textWidth = qMin(longestLine, MaxDisplayBytes) * fontMetrics().horizontalAdvance(QLatin1Char('x'));
+    const int available = viewport()->width() - gutterWidth();
+    horizontalScrollBar()->setRange(0, int(qMax(qint64(0), textWidth - available)));
+    horizontalScrollBar()->setPageStep(available);
+}
+
+void LargeFileViewer::paintEvent(QPaintEvent * /* event */)
+{
+    QPainter painter(viewport());
+    const QRect area = viewport()->rect();
+    painter.fillRect(area, currentTheme.background);
+
+    const QFontMetrics fm = fontMetrics();
+    const int lineHeight = fm.height();
+    const int gutter = gutterWidth();
+    const int textX = gutter + 4 - horizontalScrollBar()->value();
+    painter.fillRect(QRect(0, 0, gutter, area.height()), currentTheme.lineNumberBg);
+
+    if (!data) return;
+
+    const qint64 first = verticalScrollBar()->value();
+    const int rows = area.height() / lineHeight + 1;
+    const QRect textClip(gutter, 0, area.width() - gutter, area.height());
+
+    qint64 start = lineStart(first);
+    for (int row = 0; row < rows && first + row < knownLines && start <= size; ++row) {
+        const qint64 end = lineEnd(start);
+        const int y = row * lineHeight;
+
+        painter.setPen(currentTheme.lineNumber);
+        painter.drawText(QRect(0, y, gutter - 5, lineHeight), Qt::AlignRight,
+                         QString::number(first + row + 1));
+
+        painter.setClipRect(textClip);
+        if (matchOffset >= start && matchOffset < end) {
+            const int x = fm.horizontalAdvance(displayText(data + start, matchOffset - start));
+            const int width = fm.horizontalAdvance(displayText(data + matchOffset, matchLength));
+            painter.fillRect(QRect(textX + x, y, width, lineHeight), currentTheme.selection);
+        }
+        painter.setPen(currentTheme.foreground);
+        painter.drawText(textX, y + fm.ascent(),
+                         displayText(data + start, qMin(end - start, MaxDisplayBytes)));
+        painter.setClipping(false);
+
+        start = end + 1;
+    }
+}
+
+void LargeFileViewer::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    if (findBar->isVisible()) {
+        const int height = findBar->sizeHint().height();
+        const QRect cr = contentsRect();
+        findBar->setGeometry(cr.left(), cr.bottom() - height + 1, cr.width(), height);
+    }
+    updateScrollBars();
+}
+
+void LargeFileViewer::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::MoveToStartOfDocument)) {
+        verticalScrollBar()->setValue(0);
+    } else if (event->matches(QKeySequence::MoveToEndOfDocument)) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    } else if (event->key() == Qt::Key_Escape && findBar->isVisible()) {
+        findBar->hide();
+        setViewportMargins(0, 0, 0, 0);
+    } else {
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void LargeFileViewer::gotoLine(qint64 line)
+{
+    // 1-based, like the line numbers in the gutter
+    const qint64 target = qBound(qint64(0), line - 1, knownLines - 1);
+    const int rows = qMax(1, viewport()->height() / qMax(1, fontMetrics().height()));
+    verticalScrollBar()->setValue(int(qMin(qint64(INT_MAX), qMax(qint64(0), target - rows / 3))));
+}
+
+void LargeFileViewer::showGotoLineDialog()
+{
+    bool ok = false;
+    const int line = QInputDialog::getInt(this, tr("Go to Line"),
+        indexDone ? tr("Line (1 - %1):").arg(knownLines)
+                  : tr("Line (1 - %1, still indexing):").arg(knownLines),
+        int(verticalScrollBar()->value() + 1), 1, int(qMin(knownLines, qint64(INT_MAX))), 1, &ok);
+    if (ok) {
+        gotoLine(line);
+    }
+}
+
+void LargeFileViewer::showFindBar()
+{
+    findBar->show();
+    const int height = findBar->sizeHint().height();
+    setViewportMargins(0, 0, 0, height);
+    const QRect cr = contentsRect();
+    findBar->setGeometry(cr.left(), cr.bottom() - height + 1, cr.width(), height);
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void LargeFileViewer::findNext()
+{
+    const qint64 from = matchOffset >= 0 ? matchOffset + 1 : lineStart(verticalScrollBar()->value());
+    startSearch(true, from);
+}
+
+void LargeFileViewer::findPrevious()
+{
+    const qint64 from = matchOffset >= 0 ? matchOffset : lineStart(verticalScrollBar()->value());
+    startSearch(false, from);
+}
+
+void LargeFileViewer::startSearch(bool forward, qint64 from)
+{
+    // Only one search runs at a time; a stale one is cancelled first
+    if (searchCancelled) {
+        *searchCancelled = true;
+    }
+    if (searchThread) {
+        searchThread->wait();
+    }
+
+    const QByteArray needle = findEdit->text().toUtf8();
+    matchOffset = -1;
+    pendingMatch = -1;
+    if (needle.isEmpty() || !data) {
+        findStatus->clear();
+        viewport()->update();
+        return;
+    }
+
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    searchCancelled = cancel;
+    const int generation = ++searchGeneration;
+    const uchar *base = data;
+    const qint64 total = size;
+    from = qBound(qint64(0), from, total);
+    findStatus->setText(tr("Searching..."));
+
+    QThread *worker = QThread::create([this, cancel, generation, needle, base, total, from, forward]() {
+        const QByteArrayView haystack(reinterpret_cast<const char *>(base), total);
+        qint64 found;
+        if (forward) {
+            found = findForward(haystack, needle, from, total, *cancel);
+            if (found < 0) found = findForward(haystack, needle, 0, from, *cancel);
+        } else {
+            found = findBackward(haystack, needle, from, 0, *cancel);
+            if (found < 0) found = findBackward(haystack, needle, total, from, *cancel);
+        }
+        if (*cancel) return;
+        QMetaObject::invokeMethod(this, [this, generation, found]() {
+            if (generation == searchGeneration) showMatch(found);
+        }, Qt::QueuedConnection);
+    });
+
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    searchThread = worker;
+    worker->start();
+}
+
+void LargeFileViewer::showMatch(qint64 offset)
+{
+    if (offset < 0) {
+        matchOffset = -1;
+        findStatus->setText(tr("Not found"));
+        viewport()->update();
+        return;
+    }
+
+    matchOffset = offset;
+    matchLength = findEdit->text().toUtf8().size();
+
+    qint64 indexedBytes = checkpoints.isEmpty() ? 0 : checkpoints.last();
+    if (!indexDone && offset >= indexedBytes) {
+        // Wait for the index to reach the match before placing it
+        pendingMatch = offset;
+        findStatus->setText(tr("Found, indexing..."));
+        return;
+    }
+
+    const qint64 line = lineForOffset(offset);
+    findStatus->setText(tr("Line %1").arg(line + 1));
+    gotoLine(line + 1);
+    viewport()->update();
+}
@@ -0,0 +1,89 @@
+#ifndef LARGEFILEVIEWER_H
+#define LARGEFILEVIEWER_H
+
+#include <QAbstractScrollArea>
+#include <QFile>
+#include <QPointer>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "thememanager.h"
+
+class QLineEdit;
+class QLabel;
+
+// Read-only viewer for files too large to load into a QTextDocument. The
+// file is memory-mapped, a sparse line index is built on a worker thread
+// and only the visible lines are ever decoded and painted.
+class LargeFileViewer : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileViewer(const QString &path, QWidget *parent = nullptr);
+    ~LargeFileViewer();
+
+    bool isValid() const { return file.isOpen() && (data != nullptr || size == 0); }
+    QString errorString() const { return file.errorString(); }
+    QString filePath() const { return file.fileName(); }
+    qint64 lineCount() const { return knownLines; }
+    void setTheme(const EditorTheme &theme);
+
+public slots:
+    void gotoLine(qint64 line);
+    void showGotoLineDialog();
+    void showFindBar();
+    void findNext();
+    void findPrevious();
+
+signals:
+    void indexingProgress(qint64 bytesIndexed, qint64 totalBytes);
+    void indexingFinished(qint64 lineCount);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    // Offsets are recorded every IndexStride lines; the rest are found by
+    // scanning forward from the nearest checkpoint
+    static constexpr qint64 IndexStride = 64;
+
+    void startIndexing();
+    void appendIndex(const QVector<qint64> &checkpoints, qint64 lines,
+                     qint64 bytesIndexed, qint64 longestLine, bool done);
+    qint64 lineStart(qint64 line) const;
+    qint64 lineEnd(qint64 start) const;
+    qint64 lineForOffset(qint64 offset) const;
+    void startSearch(bool forward, qint64 from);
+    void showMatch(qint64 offset);
+    void updateScrollBars();
+    int gutterWidth() const;
+
+    QFile file;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+
+    QVector<qint64> checkpoints;
+    qint64 knownLines = 1;
+    qint64 longestLine = 0;
+    bool indexDone = false;
+    std::atomic<bool> cancelled{false};
+    QPointer<QThread> indexThread;
+
+    QWidget *findBar;
+    QLineEdit *findEdit;
+    QLabel *findStatus;
+    QPointer<QThread> searchThread;
+    std::shared_ptr<std::atomic<bool>> searchCancelled;
+    int searchGeneration = 0;
+    qint64 matchOffset = -1;
+    qint64 matchLength = 0;
+    qint64 pendingMatch = -1;
+
+    EditorTheme currentTheme;
+};
+
+#endif // LARGEFILEVIEWER_H
@@ -4,6 +4,15 @@
 #include "terminalwidget.h"
 #include "environmentpane.h"
 #include "thememanager.h"
+#include "fileloader.h"
+#include "largefileviewer.h"
+#include "dataviewer.h"
+#include "executionqueue.h"
+#include "sessionstate.h"
+#include "rsessionpool.h"
+#include "jobspane.h"
+#include "sessionchannel.h"
+#include "environmentmodel.h"
 
 #include <QAction>
 #include <QFileDialog>
@@ -25,8 +34,20 @@
 #include <QResizeEvent>
 #include <QDialog>
 #include <QLabel>
+#include <QStackedWidget>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QPointer>
+#include <memory>
 #include <QListWidget>
 #include <QDialogButtonBox>
+#include <QProgressBar>
+#include <QTextCursor>
+
+namespace {
+// What restartR() saves the checked objects as, in its QTemporaryDir
+const QString RestartFileName = QStringLiteral("objects.rds");
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -149,6 +170,21 @@ void MainWindow::createMenus()
     connect(sourceAct, &QAction::triggered, this, &MainWindow::sourceFile);
     codeMenu->addAction(sourceAct);
     
+    QAction *jobAct = new QAction(tr("Run Script as Background Job"), this);
+    jobAct->setShortcut(Qt::CTRL | Qt::ALT | Qt::Key_J);
+    connect(jobAct, &QAction::triggered, this, &MainWindow::runScriptAsJob);
+    codeMenu->addAction(jobAct);
+    
+    QAction *interruptAct = new QAction(tr("Interrupt R"), this);
+    interruptAct->setShortcut(Qt::CTRL | Qt::ALT | Qt::Key_C);
+    connect(interruptAct, &QAction::triggered, this, &MainWindow::interruptR);
+    codeMenu->addAction(interruptAct);
+    
+    QAction *restartAct = new QAction(tr("Restart R Keeping Checked Objects..."), this);
+    restartAct->setShortcut(Qt::CTRL | Qt::SHIFT | Qt::Key_F10);
+    connect(restartAct, &QAction::triggered, this, &MainWindow::restartR);
+    codeMenu->addAction(restartAct);
+    
     codeMenu->addSeparator();
     
     QAction *pipeAct = new QAction(tr("Insert Native Pipe |>"), this);
@@ -185,6 +221,8 @@ void MainWindow::createMenus()
     viewMenu->addAction(scriptDock->toggleViewAction());
     viewMenu->addAction(consoleDock->toggleViewAction());
     viewMenu->addAction(filesDock->toggleViewAction());
+    viewMenu->addAction(envDock->toggleViewAction());
+    viewMenu->addAction(jobsDock->toggleViewAction());
     
     viewMenu->addSeparator();
     
@@ -228,6 +266,10 @@ void MainWindow::createDockWidgets()
     
     QMenu *terminalMenu = new QMenu(this);
     
+    QAction *rAction = terminalMenu->addAction(tr("R"));
+    connect(rAction, &QAction::triggered, this, &MainWindow::addRConsole);
+    terminalMenu->addSeparator();
+    
     // Add shell options to menu
     QStringList shellPaths = {"/bin/bash", "/usr/bin/bash", 
                                "/bin/zsh", "/usr/bin/zsh",
@@ -251,7 +293,13 @@ void MainWindow::createDockWidgets()
     
     terminalMenuButton->setMenu(terminalMenu);
     
+    QPushButton *stopButton = new QPushButton(tr("Stop"), this);
+    stopButton->setMaximumWidth(60);
+    stopButton->setToolTip(tr("Interrupt R"));
+    connect(stopButton, &QPushButton::clicked, this, &MainWindow::interruptR);
+    
     toolbarLayout->addWidget(terminalMenuButton);
+    toolbarLayout->addWidget(stopButton);
     toolbarLayout->addStretch();
     
     consoleLayout->addWidget(toolbarWidget);
@@ -260,19 +308,43 @@ void MainWindow::createDockWidgets()
     consoleDock->setWidget(consoleWidget);
     addDockWidget(Qt::BottomDockWidgetArea, consoleDock);
     
-    // Add R console as first tab
-    console = new TerminalWidget("R", this);
-    consoleTabs->addTab(console, "R Console");
-    
-    // Handle tab close
-    connect(consoleTabs, &QTabWidget::tabCloseRequested, this, [this](int index) {
-        // Don't allow closing the R console (index 0)
-        if (index > 0) {
-            QWidget *widget = consoleTabs->widget(index);
-            consoleTabs->removeTab(index);
-            delete widget;
+    // Status of the active R session; rewired by setActiveConsole()
+    sessionStateLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(sessionStateLabel);
+    sessionStateLabel->hide();
+
+    // Quick commands would only make the label flicker; it appears once
+    // R has been busy for a second and then counts up
+    sessionStateTimer = new QTimer(this);
+    sessionStateTimer->setInterval(1000);
+    connect(sessionStateTimer, &QTimer::timeout, this, [this]() {
+        if (!console || !console->sessionState()) return;
+        const qint64 seconds = console->sessionState()->busyElapsed() / 1000;
+        sessionStateLabel->setText(tr("R: running (%1:%2)")
+            .arg(seconds / 60, 2, 10, QChar('0'))
+            .arg(seconds % 60, 2, 10, QChar('0')));
+        sessionStateLabel->show();
+    });
+
+    // One environment pane per R session, showing the active one
+    envStack = new QStackedWidget(this);
+
+    // Add R console as first tab. The pool is still empty at startup; it
+    // fills up in the background for the consoles opened later.
+    sessionPool = new RSessionPool(this);
+    addRConsole();
+
+    // Run actions, the environment pane and the status bar follow the R
+    // console last selected; other terminals leave it as it is
+    connect(consoleTabs, &QTabWidget::currentChanged, this, [this](int index) {
+        TerminalWidget *terminal = qobject_cast<TerminalWidget*>(consoleTabs->widget(index));
+        if (terminal && envPanes.contains(terminal)) {
+            setActiveConsole(terminal);
         }
     });
+
+    // Handle tab close
+    connect(consoleTabs, &QTabWidget::tabCloseRequested, this, &MainWindow::closeConsoleTab);
     
     // Files dock
     filesDock = new QDockWidget(tr("Files"), this);
@@ -284,10 +356,33 @@ void MainWindow::createDockWidgets()
     // Environment dock
     envDock = new QDockWidget(tr("Environment"), this);
     envDock->setObjectName("envDock");
-    envPane = new EnvironmentPane(console, this);
-    envDock->setWidget(envPane);
+    envDock->setWidget(envStack);
     addDockWidget(Qt::RightDockWidgetArea, envDock);
     tabifyDockWidget(filesDock, envDock);
+
+    // Jobs dock
+    jobsDock = new QDockWidget(tr("Jobs"), this);
+    jobsDock->setObjectName("jobsDock");
+    jobsPane = new JobsPane(this);
+    connect(jobsPane, &JobsPane::importRequested, this, [this](const QString &file) {
+        if (!console) return;
+        QString rFile = file;
+        rFile.replace('\\', '/').replace('\'', "\\'");
+        console->evaluate(QString("list2env(readRDS('%1'), envir = .GlobalEnv)").arg(rFile));
+    });
+    connect(fileBrowser, &FileBrowser::runBatchRequested, this, [this](const QStringList &scripts) {
+        jobsPane->runBatch(scripts);
+        jobsDock->show();
+        jobsDock->raise();
+    });
+    connect(fileBrowser, &FileBrowser::runGridRequested, this, [this](const QString &script) {
+        jobsPane->runGrid(script);
+        jobsDock->show();
+        jobsDock->raise();
+    });
+    jobsDock->setWidget(jobsPane);
+    addDockWidget(Qt::RightDockWidgetArea, jobsDock);
+    tabifyDockWidget(envDock, jobsDock);
     setTabPosition(Qt::RightDockWidgetArea, QTabWidget::North);
 }
 
@@ -311,7 +406,8 @@ void MainWindow::setupConnections()
         QString suffix = fileInfo.suffix().toLower();
         
         // Check if it's a supported file type
-        QStringList supportedTypes = {"r", "rmd", "qmd", "h", "c", "hpp", "cpp", "rproject"};
+        QStringList supportedTypes = {"r", "rmd", "qmd", "h", "c", "hpp", "cpp", "rproject",
+                                      "txt", "md", "csv", "tsv", "log"};
         
         if (supportedTypes.contains(suffix)) {
             // Special handling for .rproject files
@@ -324,26 +420,13 @@ void MainWindow::setupConnections()
                 // Set R working directory
                 if (console) {
                     QString rCommand = QString("setwd('%1')").arg(projectDir.replace('\\', '/'));
-                    console->executeCommand(rCommand);
+                    console->evaluate(rCommand);
                     statusBar()->showMessage(tr("Opened project: %1").arg(fileInfo.fileName()), 5000);
                 }
             }
             
             // Open the file
-            QFile file(path);
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QTextStream in(&file);
-                QString content = in.readAll();
-                file.close();
-                
-                addNewEditorTab(fileInfo.fileName());
-                CodeEditor *editor = getCurrentEditor();
-                if (editor) {
-                    editor->setPlainText(content);
-                    editor->setProperty("filePath", path);
-                    editor->document()->setModified(false);
-                }
-            }
+            openFileInEditor(path);
         }
     });
 }
@@ -369,9 +452,12 @@ void MainWindow::loadSettings()
         // This ensures they take 100% of the right column height
         addDockWidget(Qt::RightDockWidgetArea, filesDock);
         addDockWidget(Qt::RightDockWidgetArea, envDock);
+        addDockWidget(Qt::RightDockWidgetArea, jobsDock);
         tabifyDockWidget(filesDock, envDock);
+        tabifyDockWidget(envDock, jobsDock);
         filesDock->setVisible(true);
         envDock->setVisible(true);
+        jobsDock->setVisible(true);
         // Raise files dock to be the active tab
         filesDock->raise();
 
@@ -453,6 +539,7 @@ void MainWindow::setDefaultLayoutSizes()
         if (consoleDock) consoleDock->installEventFilter(this);
         if (filesDock) filesDock->installEventFilter(this);
         if (envDock) envDock->installEventFilter(this);
+        if (jobsDock) jobsDock->installEventFilter(this);
         if (editorTabs) editorTabs->installEventFilter(this);
         
         // Also install on splitters to catch their resize events
@@ -491,6 +578,9 @@ void MainWindow::updateTabTitle(int index, bool modified)
     
     CodeEditor *editor = qobject_cast<CodeEditor*>(editorTabs->widget(index));
     if (!editor) return;
+
+    // Chunked loads toggle the modified flag on every append
+    if (editor->property("loading").toBool()) return;
     
     // Get the base title (file name or "Untitled")
     QString baseTitle = editorTabs->tabText(index);
@@ -519,9 +609,11 @@ void MainWindow::updateTabTitle(int index, bool modified)
     // Set tooltip
     editorTabs->setTabToolTip(index, modified ? tr("Modified - %1").arg(baseTitle) : baseTitle);
     
-    // Apply stylesheet to make current tab italic if modified
-    if (index == editorTabs->currentIndex()) {
-        editorTabs->setStyleSheet(stylesheet);
+    // Apply stylesheet to make current tab italic if modified. It goes on the
+    // tab bar only, and only when it changes: a sheet on editorTabs would
+    // re-polish every editor inside it on each keystroke that flips the state.
+    if (index == editorTabs->currentIndex() && editorTabs->tabBar()->styleSheet() != stylesheet) {
+        editorTabs->tabBar()->setStyleSheet(stylesheet);
     }
 }
 
@@ -554,25 +646,382 @@ void MainWindow::openFile()
             // Set R working directory
             if (console) {
                 QString rCommand = QString("setwd('%1')").arg(projectDir.replace('\\', '/'));
-                console->executeCommand(rCommand);
+                console->evaluate(rCommand);
                 statusBar()->showMessage(tr("Opened project: %1").arg(fileInfo.fileName()), 5000);
             }
         }
         
-        QFile file(fileName);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QString content = in.readAll();
-            file.close();
-            
-            addNewEditorTab(fileInfo.fileName());
-            CodeEditor *editor = getCurrentEditor();
-            if (editor) {
-                editor->setPlainText(content);
-                editor->setProperty("filePath", fileName);
-                editor->document()->setModified(false);
+        openFileInEditor(fileName);
+    }
+}
+
+void MainWindow::openFileInEditor(const QString &path)
+{
+    QFileInfo fileInfo(path);
+    QString suffix = fileInfo.suffix().toLower();
+
+    // Files above the threshold cost several times their size in RAM as a
+    // QTextDocument; offer the memory-mapped viewer instead
+    QSettings settings("Q", "Q");
+    const qint64 viewerThreshold = settings.value("editor/largeFileViewerBytes",
+                                                  qint64(50) * 1024 * 1024).toLongLong();
+    if (viewerThreshold > 0 && fileInfo.size() >= viewerThreshold) {
+        QMessageBox::StandardButton reply = QMessageBox::question(this,
+            tr("Large File"),
+            tr("%1 is %2 MB.\nOpen it in the read-only large file viewer instead of the editor?")
+                .arg(fileInfo.fileName())
+                .arg(fileInfo.size() / (1024 * 1024)),
+            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+            QMessageBox::Yes);
+
+        if (reply == QMessageBox::Cancel) {
+            return;
+        }
+        if (reply == QMessageBox::Yes) {
+            openLargeFileViewer(path);
+            return;
+        }
+    }
+
+    addNewEditorTab(fileInfo.fileName());
+    CodeEditor *editor = getCurrentEditor();
+    if (!editor) return;
+
+    editor->setMarkdownMode(suffix == "rmd" || suffix == "qmd");
+    editor->setProperty("filePath", path);
+
+    // Read and decode off the GUI thread and append chunk by chunk, so a
+    // huge file never freezes the window and what is already loaded can be
+    // scrolled. The tab is read-only until the load completes.
+    editor->setProperty("loading", true);
+    editor->setReadOnly(true);
+    editor->document()->setUndoRedoEnabled(false);
+
+    FileLoader *loader = new FileLoader(path, editor);
+
+    // Progress indicator with a cancel button in the status bar
+    QWidget *progressWidget = new QWidget(this);
+    QHBoxLayout *progressLayout = new QHBoxLayout(progressWidget);
+    progressLayout->setContentsMargins(0, 0, 0, 0);
+    QLabel *progressLabel = new QLabel(tr("Loading %1").arg(fileInfo.fileName()), progressWidget);
+    QProgressBar *progressBar = new QProgressBar(progressWidget);
+    progressBar->setRange(0, 100);
+    progressBar->setMaximumWidth(150);
+    QPushButton *cancelButton = new QPushButton(tr("Cancel"), progressWidget);
+    progressLayout->addWidget(progressLabel);
+    progressLayout->addWidget(progressBar);
+    progressLayout->addWidget(cancelButton);
+    statusBar()->addPermanentWidget(progressWidget);
+    progressWidget->hide();
+
+    // Only show progress for loads that take a noticeable amount of time
+    QTimer::singleShot(300, progressWidget, &QWidget::show);
+    connect(loader, &QObject::destroyed, progressWidget, &QObject::deleteLater);
+
+    connect(loader, &FileLoader::chunkLoaded, editor,
+            [editor, progressBar](const QString &text, qint64 bytesRead, qint64 totalBytes) {
+        QTextCursor cursor(editor->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(text);
+        if (totalBytes > 0) {
+            progressBar->setValue(int(bytesRead * 100 / totalBytes));
+        }
+    });
+
+    connect(loader, &FileLoader::invalidText, this, [this, fileInfo]() {
+        statusBar()->showMessage(tr("%1 is not valid UTF-8; invalid bytes are shown as �")
+                                     .arg(fileInfo.fileName()), 5000);
+    });
+
+    connect(loader, &FileLoader::finished, this, [editor, loader]() {
+        editor->document()->setUndoRedoEnabled(true);
+        editor->document()->setModified(false);
+        editor->setReadOnly(false);
+        editor->setProperty("loading", false);
+        loader->deleteLater();
+    });
+
+    connect(loader, &FileLoader::failed, this, [this, editor, path](const QString &error) {
+        QMessageBox::warning(this, tr("Open File"),
+            tr("Could not open %1:\n%2").arg(path, error));
+        closeEditor(editor);
+    });
+
+    connect(cancelButton, &QPushButton::clicked, this, [this, editor, loader]() {
+        // A partially loaded document must never be saved over the file
+        loader->cancel();
+        closeEditor(editor);
+        statusBar()->showMessage(tr("Loading cancelled"), 3000);
+    });
+
+    loader->start();
+}
+
+void MainWindow::openLargeFileViewer(const QString &path)
+{
+    LargeFileViewer *viewer = new LargeFileViewer(path, this);
+    if (!viewer->isValid()) {
+        QMessageBox::warning(this, tr("Open File"),
+            tr("Could not map %1:\n%2").arg(path, viewer->errorString()));
+        delete viewer;
+        return;
+    }
+
+    const QString fileName = QFileInfo(path).fileName();
+    int index = editorTabs->addTab(viewer, tr("%1 [read-only]").arg(fileName));
+    editorTabs->setTabToolTip(index, path);
+    editorTabs->setCurrentIndex(index);
+
+    connect(viewer, &LargeFileViewer::indexingProgress, this,
+            [this, fileName](qint64 bytesIndexed, qint64 totalBytes) {
+        if (totalBytes > 0) {
+            statusBar()->showMessage(tr("Indexing %1: %2%")
+                .arg(fileName).arg(bytesIndexed * 100 / totalBytes), 2000);
+        }
+    });
+    connect(viewer, &LargeFileViewer::indexingFinished, this, [this, fileName](qint64 lines) {
+        statusBar()->showMessage(tr("%1: %2 lines").arg(fileName).arg(lines), 5000);
+    });
+}
+
+void MainWindow::openDataViewer(SessionChannel *channel, const QStringList &path, const QString &title)
+{
+    if (!channel) return;
+
+    DataViewer *viewer = new DataViewer(channel, path, this);
+    int index = editorTabs->addTab(viewer, tr("View: %1").arg(title));
+    editorTabs->setTabToolTip(index, path.join(" > "));
+    editorTabs->setCurrentIndex(index);
+}
+
+TerminalWidget *MainWindow::addRConsole()
+{
+    const QString title = envPanes.isEmpty()
+        ? tr("R Console") : tr("R Console %1").arg(++rConsoleNumber);
+    return insertRConsole(consoleTabs->count(), title);
+}
+
+TerminalWidget *MainWindow::insertRConsole(int index, const QString &title)
+{
+    TerminalWidget *terminal = sessionPool->take(this);
+    index = consoleTabs->insertTab(index, terminal, title);
+
+    connect(terminal, &TerminalWidget::interruptIgnored, this, [this, terminal]() {
+        const auto answer = QMessageBox::question(this, tr("Interrupt R"),
+            tr("R has not responded to the interrupt; it may be running compiled code "
+               "that never checks for one.\n\nTerminate the R session?"),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+        // R may have come back while the question was up
+        if (answer == QMessageBox::Yes && terminal->sessionState()->isBusy()) {
+            terminal->terminateShell();
+        }
+    });
+
+    EnvironmentPane *pane = new EnvironmentPane(terminal, envStack);
+    connect(pane, &EnvironmentPane::viewRequested, this, [this, terminal](const QStringList &path, const QString &title) {
+        openDataViewer(terminal->sessionChannel(), path, title);
+    });
+    envStack->addWidget(pane);
+    envPanes.insert(terminal, pane);
+
+    consoleTabs->setCurrentIndex(index);
+    setActiveConsole(terminal);
+    return terminal;
+}
+
+void MainWindow::setActiveConsole(TerminalWidget *terminal)
+{
+    if (terminal == console) return;
+
+    for (const QMetaObject::Connection &connection : activeConsoleConnections) {
+        disconnect(connection);
+    }
+    activeConsoleConnections.clear();
+    sessionStateTimer->stop();
+    sessionStateLabel->hide();
+    statusBar()->clearMessage();
+
+    console = terminal;
+    if (!console) return;
+    envStack->setCurrentWidget(envPanes.value(console));
+
+    if (ExecutionQueue *queue = console->executionQueue()) {
+        auto showPending = [this](int chunks) {
+            if (chunks > 0) {
+                statusBar()->showMessage(tr("R is busy: %n chunk(s) queued", "", chunks));
+            } else {
+                statusBar()->clearMessage();
+            }
+        };
+        activeConsoleConnections << connect(queue, &ExecutionQueue::pendingChanged, this, showPending);
+        if (queue->pendingCount() > 0) {
+            showPending(queue->pendingCount());
+        }
+    }
+    if (SessionState *state = console->sessionState()) {
+        activeConsoleConnections << connect(state, &SessionState::busyChanged, this, [this](bool busy) {
+            if (busy) {
+                sessionStateTimer->start();
+            } else {
+                sessionStateTimer->stop();
+                sessionStateLabel->hide();
+            }
+        });
+        if (state->isBusy()) {
+            sessionStateTimer->start();
+        }
+    }
+}
+
+void MainWindow::restartR()
+{
+    TerminalWidget *old = console;
+    if (!old) return;
+
+    const QStringList names = envPanes.value(old)->checkedNames();
+    SessionChannel *channel = old->sessionChannel();
+    if (names.isEmpty() || !channel || !channel->isConnected()) {
+        const QString question = names.isEmpty()
+            ? tr("No objects are checked in the environment pane. Restart R with an empty workspace?")
+            : tr("qide is not connected, so objects cannot be kept. Restart R with an empty workspace?");
+        if (QMessageBox::question(this, tr("Restart R"), question) != QMessageBox::Yes) return;
+        insertRConsole(consoleTabs->indexOf(old), consoleTabs->tabText(consoleTabs->indexOf(old)));
+        closeConsoleTab(consoleTabs->indexOf(old));
+        return;
+    }
+
+    // The snapshot holds the user's data, so it goes into a private
+    // directory, removed once the new session has read it back
+    auto dir = std::make_shared<QTemporaryDir>();
+    if (!dir->isValid()) {
+        QMessageBox::warning(this, tr("Restart R"), tr("Cannot save the objects: %1").arg(dir->errorString()));
+        return;
+    }
+    // Uncompressed RDS: writing and reading are bound by the disk, not
+    // by the compressor
+    const QString file = dir->filePath(RestartFileName);
+    QString rFile = file;
+    rFile.replace('\\', '/').replace('\'', "\\'");
+    QStringList quoted;
+    for (QString name : names) {
+        quoted << "'" + name.replace('\\', "\\\\").replace('\'', "\\'") + "'";
+    }
+    auto saving = std::make_shared<QElapsedTimer>();
+    saving->start();
+    const quint32 id = channel->evaluate(
+        QString("saveRDS(mget(c(%1), envir = .GlobalEnv), '%2', compress = FALSE)")
+            .arg(quoted.join(", "), rFile));
+    statusBar()->showMessage(tr("Saving %n object(s) before restarting R...", "", names.size()));
+
+    QPointer<TerminalWidget> target(old);
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = connect(channel, &SessionChannel::evalFinished, this,
+                          [this, target, connection, id, dir, file, names, saving](const EvalResult &result) {
+        if (result.requestId != id) return;
+        disconnect(*connection);
+
+        if (!result.ok) {
+            statusBar()->clearMessage();
+            QMessageBox::warning(this, tr("Restart R"), tr("Cannot save the objects: %1").arg(result.error));
+            return;
+        }
+        // The console may have been closed while R was saving
+        if (!target) return;
+        const qint64 saveTime = saving->elapsed();
+        const int index = consoleTabs->indexOf(target);
+        TerminalWidget *fresh = insertRConsole(index, consoleTabs->tabText(index));
+        closeConsoleTab(consoleTabs->indexOf(target));
+        restoreObjects(fresh, dir, names.size(), QFileInfo(file).size(), saveTime);
+    });
+}
+
+void MainWindow::restoreObjects(TerminalWidget *terminal, const std::shared_ptr<QTemporaryDir> &dir,
+                                int count, qint64 bytes, qint64 saveTime)
+{
+    SessionChannel *channel = terminal->sessionChannel();
+    QString rFile = dir->filePath(RestartFileName);
+    rFile.replace('\\', '/').replace('\'', "\\'");
+    const QString code = QString(
+        "local({"
+        "  path <- '%1';"
+        "  on.exit(unlink(path));"
+        "  list2env(readRDS(path), envir = .GlobalEnv);"
+        "  invisible(NULL)"
+        "})").arg(rFile);
+
+    auto elapsed = std::make_shared<QElapsedTimer>();
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    auto load = [this, channel, code, connection, elapsed, dir, count, bytes, saveTime]() {
+        elapsed->start();
+        const quint32 id = channel->evaluate(code);
+        *connection = connect(channel, &SessionChannel::evalFinished, this,
+                              [this, connection, elapsed, id, dir, count, bytes, saveTime](const EvalResult &result) {
+            if (result.requestId != id) return;
+            disconnect(*connection);
+            if (!result.ok) {
+                statusBar()->clearMessage();
+                QMessageBox::warning(this, tr("Restart R"), tr("Cannot restore the objects: %1").arg(result.error));
+                return;
+            }
+            statusBar()->showMessage(tr("Restarted R keeping %n object(s) (%1, saved in %2 s, loaded in %3 s)",
+                                        "", count)
+                .arg(EnvironmentModel::formatSize(bytes))
+                .arg(saveTime / 1000.0, 0, 'f', 2)
+                .arg(elapsed->elapsed() / 1000.0, 0, 'f', 2), 10000);
+        });
+    };
+
+    // A pooled session is usually connected already; a fresh one connects
+    // once its profile has loaded qide
+    if (channel->isConnected()) {
+        load();
+    } else {
+        statusBar()->showMessage(tr("Waiting for R to start..."));
+        *connection = connect(channel, &SessionChannel::connected, this, [connection, load]() {
+            disconnect(*connection);
+            load();
+        });
+    }
+}
+
+void MainWindow::closeConsoleTab(int index)
+{
+    TerminalWidget *terminal = qobject_cast<TerminalWidget*>(consoleTabs->widget(index));
+    if (terminal && envPanes.contains(terminal)) {
+        // Keep at least one R console around
+        if (envPanes.size() == 1) return;
+
+        EnvironmentPane *pane = envPanes.take(terminal);
+        if (terminal == console) {
+            // Hand over to the first remaining R console
+            for (int i = 0; i < consoleTabs->count(); ++i) {
+                TerminalWidget *other = qobject_cast<TerminalWidget*>(consoleTabs->widget(i));
+                if (other && other != terminal && envPanes.contains(other)) {
+                    setActiveConsole(other);
+                    break;
+                }
             }
         }
+        envStack->removeWidget(pane);
+        delete pane;
+    }
+
+    QWidget *widget = consoleTabs->widget(index);
+    consoleTabs->removeTab(index);
+    delete widget;
+}
+
+void MainWindow::closeEditor(QWidget *editor)
+{
+    const int index = editorTabs->indexOf(editor);
+    if (index < 0) return;
+
+    editorTabs->removeTab(index);
+    editor->deleteLater();
+
+    // Add new tab if all closed
+    if (editorTabs->count() == 0) {
+        addNewEditorTab();
     }
 }
 
@@ -589,7 +1038,7 @@ void MainWindow::openDirectory()
         // Set R working directory
         if (console) {
             QString rCommand = QString("setwd('%1')").arg(dirPath.replace('\\', '/'));
-            console->executeCommand(rCommand);
+            console->evaluate(rCommand);
             statusBar()->showMessage(tr("Working directory: %1").arg(dirPath), 5000);
         }
     }
@@ -650,7 +1099,7 @@ void MainWindow::createProject()
         
         if (console) {
             QString rCommand = QString("setwd('%1')").arg(dirPath.replace('\\', '/'));
-            console->executeCommand(rCommand);
+            console->evaluate(rCommand);
         }
         
         QMessageBox::information(this, tr("Project Created"),
@@ -663,10 +1112,20 @@ void MainWindow::createProject()
     }
 }
 
+bool MainWindow::isLoading(CodeEditor *editor)
+{
+    if (!editor->property("loading").toBool()) return false;
+    statusBar()->showMessage(tr("Wait until the file has finished loading"), 3000);
+    return true;
+}
+
 void MainWindow::saveFile()
 {
     CodeEditor *editor = getCurrentEditor();
     if (!editor) return;
+    // filePath is set before a chunked load starts; saving now would
+    // truncate the file to what has been read so far
+    if (isLoading(editor)) return;
     
     QString filePath = editor->property("filePath").toString();
     if (filePath.isEmpty()) {
@@ -688,6 +1147,7 @@ void MainWindow::saveFileAs()
 {
     CodeEditor *editor = getCurrentEditor();
     if (!editor) return;
+    if (isLoading(editor)) return;
     
     // Get current file path to determine default extension
     QString currentPath = editor->property("filePath").toString();
@@ -737,6 +1197,8 @@ void MainWindow::saveFileAs()
             file.close();
             
             editor->setProperty("filePath", fileName);
+            const QString savedSuffix = QFileInfo(fileName).suffix().toLower();
+            editor->setMarkdownMode(savedSuffix == "rmd" || savedSuffix == "qmd");
             editor->document()->setModified(false);
             editorTabs->setTabText(editorTabs->currentIndex(), QFileInfo(fileName).fileName());
             statusBar()->showMessage(tr("File saved: %1").arg(fileName), 3000);
@@ -754,7 +1216,7 @@ void MainWindow::runCurrentLine()
     if (!selection.isEmpty()) {
         // If there's a selection, run it
         selection.replace(QChar(0x2029), '\n');
-        console->executeCommand(selection);
+        console->runCode(selection);
         return;
     }
     
@@ -764,7 +1226,7 @@ void MainWindow::runCurrentLine()
     QString line = cursor.selectedText();
     
     if (!line.trimmed().isEmpty()) {
-        console->executeCommand(line);
+        console->runCode(line);
     }
 }
 
@@ -777,7 +1239,7 @@ void MainWindow::runSelection()
     if (!selection.isEmpty()) {
         // Qt uses Unicode paragraph separator, replace with newline
         selection.replace(QChar(0x2029), '\n');
-        console->executeCommand(selection);
+        console->runCode(selection);
     }
 }
 
@@ -788,7 +1250,7 @@ void MainWindow::runAll()
     
     QString code = editor->toPlainText();
     if (!code.isEmpty()) {
-        console->executeCommand(code);
+        console->runCode(code);
     }
 }
 
@@ -807,7 +1269,36 @@ void MainWindow::sourceFile()
     // Use forward slashes for R
     filePath.replace('\\', '/');
     QString command = QString("source('%1')").arg(filePath);
-    console->executeCommand(command);
+    console->runCode(command);
+}
+
+void MainWindow::runScriptAsJob()
+{
+    CodeEditor *editor = getCurrentEditor();
+    if (!editor) return;
+    if (isLoading(editor)) return;
+
+    const QString filePath = editor->property("filePath").toString();
+    if (filePath.isEmpty()) {
+        QMessageBox::warning(this, tr("Run Script as Background Job"),
+            tr("Please save the file before running it as a job."));
+        return;
+    }
+    // The job reads the script from disk
+    if (editor->document()->isModified()) {
+        saveFile();
+    }
+
+    jobsPane->runScript(filePath);
+    jobsDock->show();
+    jobsDock->raise();
+}
+
+void MainWindow::interruptR()
+{
+    if (console) {
+        console->interrupt();
+    }
 }
 
 void MainWindow::changeTheme()
@@ -888,51 +1379,114 @@ void MainWindow::changeTheme()
     // Handle double-click to apply immediately
     connect(themeList, &QListWidget::itemDoubleClicked, &dialog, &QDialog::accept);
     
-    // Focus search box initially
-    searchBox->setFocus();
+    // Live preview while browsing. Palette and highlighter formats for the
+    // visible editor change on every selection; the stylesheet re-polish and
+    // recoloring every open tab wait until the selection settles.
+    const EditorTheme originalTheme = themeMgr.currentTheme();
+    EditorTheme previewedTheme;
+    QString widgetsTheme = originalTheme.name;
+    
+    QTimer settleTimer;
+    settleTimer.setSingleShot(true);
+    settleTimer.setInterval(250);
+    connect(&settleTimer, &QTimer::timeout, &dialog, [&]() {
+        themeMgr.applyStyleSheet(previewedTheme);
+        applyThemeToWidgets(previewedTheme);
+        widgetsTheme = previewedTheme.name;
+    });
     
-    if (dialog.exec() == QDialog::Accepted && themeList->currentItem()) {
-        QString selectedTheme = themeList->currentItem()->text();
-        
-        qDebug() << "Applying theme:" << selectedTheme;
-        
-        themeMgr.setCurrentTheme(selectedTheme);
-        EditorTheme theme = themeMgr.currentTheme();
-        
-        // Validate theme before applying
+    connect(themeList, &QListWidget::currentItemChanged, &dialog,
+            [&](QListWidgetItem *current, QListWidgetItem *) {
+        if (!current) return;
+        EditorTheme theme = themeMgr.getTheme(current->text());
         if (theme.name.isEmpty() || !theme.background.isValid() || !theme.foreground.isValid()) {
-            qWarning() << "Invalid theme loaded, skipping application";
-            QMessageBox::warning(this, tr("Theme Error"),
-                tr("Failed to load theme: %1\nPlease try another theme.").arg(selectedTheme));
             return;
         }
-        
-        // Apply global stylesheet to the entire application
-        QString stylesheet = themeMgr.toStyleSheet(theme);
-        qApp->setStyleSheet(stylesheet);
-        
-        // Apply to all editor tabs
-        for (int i = 0; i < editorTabs->count(); ++i) {
-            CodeEditor *editor = qobject_cast<CodeEditor*>(editorTabs->widget(i));
-            if (editor) {
-                editor->setTheme(theme);
+        previewedTheme = theme;
+        themeMgr.applyPalette(theme);
+        if (CodeEditor *editor = qobject_cast<CodeEditor*>(editorTabs->currentWidget())) {
+            editor->previewTheme(theme);
+        }
+        settleTimer.start();
+    });
+    
+    // Focus search box initially
+    searchBox->setFocus();
+    
+    const bool accepted = dialog.exec() == QDialog::Accepted && themeList->currentItem();
+    // The preview lambdas capture locals that go away before the list does
+    themeList->disconnect(&dialog);
+    settleTimer.stop();
+    
+    if (!accepted) {
+        // Put back whatever the preview changed
+        if (!previewedTheme.name.isEmpty()) {
+            themeMgr.applyTheme(originalTheme);
+            if (widgetsTheme != originalTheme.name) {
+                applyThemeToWidgets(originalTheme);
+            } else if (CodeEditor *editor = qobject_cast<CodeEditor*>(editorTabs->currentWidget())) {
+                editor->setTheme(originalTheme);
             }
         }
-        
-        // Apply to console (if it exists)
-        if (console) {
-            console->setTheme(theme);
+        return;
+    }
+    
+    QString selectedTheme = themeList->currentItem()->text();
+    
+    qDebug() << "Applying theme:" << selectedTheme;
+    
+    themeMgr.setCurrentTheme(selectedTheme);
+    EditorTheme theme = themeMgr.currentTheme();
+    
+    // Validate theme before applying
+    if (theme.name.isEmpty() || !theme.background.isValid() || !theme.foreground.isValid()) {
+        qWarning() << "Invalid theme loaded, skipping application";
+        QMessageBox::warning(this, tr("Theme Error"),
+            tr("Failed to load theme: %1\nPlease try another theme.").arg(selectedTheme));
+        themeMgr.applyTheme(originalTheme);
+        applyThemeToWidgets(originalTheme);
+        return;
+    }
+    
+    // setCurrentTheme installed the application stylesheet and palette
+    // (both no-ops if the preview already did); the widgets only need
+    // updating if the preview had not settled on this theme yet
+    if (widgetsTheme != theme.name) {
+        applyThemeToWidgets(theme);
+    }
+    
+    qDebug() << "Theme applied successfully:" << selectedTheme;
+}
+
+void MainWindow::applyThemeToWidgets(const EditorTheme &theme)
+{
+    // Apply to all editor tabs
+    for (int i = 0; i < editorTabs->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(editorTabs->widget(i));
+        if (editor) {
+            editor->setTheme(theme);
         }
-        
-        // Apply to all terminal tabs
-        for (int i = 0; i < consoleTabs->count(); ++i) {
-            TerminalWidget *terminal = qobject_cast<TerminalWidget*>(consoleTabs->widget(i));
-            if (terminal) {
-                terminal->setTheme(theme);
-            }
+    }
+    
+    // Apply to read-only large file viewers
+    for (int i = 0; i < editorTabs->count(); ++i) {
+        LargeFileViewer *viewer = qobject_cast<LargeFileViewer*>(editorTabs->widget(i));
+        if (viewer) {
+            viewer->setTheme(theme);
+        }
+    }
+    
+    // Apply to console (if it exists)
+    if (console) {
+        console->setTheme(theme);
+    }
+    
+    // Apply to all terminal tabs
+    for (int i = 0; i < consoleTabs->count(); ++i) {
+        TerminalWidget *terminal = qobject_cast<TerminalWidget*>(consoleTabs->widget(i));
+        if (terminal) {
+            terminal->setTheme(theme);
         }
-        
-        qDebug() << "Theme applied successfully:" << selectedTheme;
     }
 }
 
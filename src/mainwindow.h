@@ -9,13 +9,22 @@
 #include <QMenuBar>
 #include <QStatusBar>
 #include <QPushButton>
+#include <QHash>
+#include <memory>
 
 class QSplitter;
+class QLabel;
+class QStackedWidget;
+class QTimer;
+class QTemporaryDir;
 
 class CodeEditor;
 class FileBrowser;
 class TerminalWidget;
 class EnvironmentPane;
+class JobsPane;
+class RSessionPool;
+class SessionChannel;
 
 class MainWindow : public QMainWindow
 {
@@ -36,6 +45,11 @@ private slots:
     void runSelection();
     void runAll();
     void sourceFile();
+    void runScriptAsJob();
+    void interruptR();
+    TerminalWidget *addRConsole();
+    void restartR();
+    void closeConsoleTab(int index);
     void changeTheme();
     void about();
 
@@ -57,14 +71,23 @@ private:
     QDockWidget *consoleDock;
     QDockWidget *filesDock;
     QDockWidget *envDock;
+    QDockWidget *jobsDock;
     
     // Console tabs
     QTabWidget *consoleTabs;
     
     // Components
+    // The active R console: the R tab last selected
     TerminalWidget *console;
     FileBrowser *fileBrowser;
-    EnvironmentPane *envPane;
+    QStackedWidget *envStack;
+    QHash<TerminalWidget*, EnvironmentPane*> envPanes;
+    JobsPane *jobsPane;
+    RSessionPool *sessionPool;
+    int rConsoleNumber = 1;
+    QLabel *sessionStateLabel;
+    QTimer *sessionStateTimer;
+    QList<QMetaObject::Connection> activeConsoleConnections;
     
     // Menus
     QMenu *fileMenu;
@@ -78,8 +101,21 @@ private:
     QSplitter *m_leftSplitter = nullptr;
     
     CodeEditor* getCurrentEditor();
+    // True (with a status message) while a chunked load is in progress
+    bool isLoading(CodeEditor *editor);
     void addNewEditorTab(const QString &title = "Untitled");
+    void openFileInEditor(const QString &path);
+    void openLargeFileViewer(const QString &path);
+    void openDataViewer(SessionChannel *channel, const QStringList &path, const QString &title);
+    void setActiveConsole(TerminalWidget *terminal);
+    TerminalWidget *insertRConsole(int index, const QString &title);
+    // Loads the objects restartR() saved into dir; saveTime (ms) is
+    // reported along with the load time
+    void restoreObjects(TerminalWidget *terminal, const std::shared_ptr<QTemporaryDir> &dir,
+                        int count, qint64 bytes, qint64 saveTime);
+    void closeEditor(QWidget *editor);
     void updateTabTitle(int index, bool modified);
+    void applyThemeToWidgets(const EditorTheme &theme);
 };
 
 #endif // MAINWINDOW_H
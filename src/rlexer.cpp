@@ -0,0 +1,352 @@
+#include "rlexer.h"
+#include <QLatin1String>
+#include <QtGlobal>
+
+namespace {
+
+const QLatin1String keywords[] = {
+    QLatin1String("if"), QLatin1String("else"), QLatin1String("for"),
+    QLatin1String("while"), QLatin1String("repeat"), QLatin1String("function"),
+    QLatin1String("return"), QLatin1String("next"), QLatin1String("break"),
+    QLatin1String("TRUE"), QLatin1String("FALSE"), QLatin1String("NULL"),
+    QLatin1String("NA"), QLatin1String("NaN"), QLatin1String("Inf"),
+    QLatin1String("in"), QLatin1String("NA_integer_"), QLatin1String("NA_real_"),
+    QLatin1String("NA_character_"), QLatin1String("NA_complex_")
+};
+
+inline bool isDigit(QChar c)
+{
+    return c.unicode() >= '0' && c.unicode() <= '9';
+}
+
+inline bool isHexDigit(QChar c)
+{
+    const char16_t u = c.unicode();
+    return (u >= '0' && u <= '9') || (u >= 'a' && u <= 'f') || (u >= 'A' && u <= 'F');
+}
+
+} // namespace
+
+bool RLexer::isKeyword(QStringView word)
+{
+    for (const QLatin1String &keyword : keywords) {
+        if (keyword.size() == word.size() && word == keyword) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RLexer::isIdentifierStart(QChar c)
+{
+    const char16_t u = c.unicode();
+    if (u < 128) {
+        return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || u == '.';
+    }
+    return c.isLetter();
+}
+
+bool RLexer::isIdentifierChar(QChar c)
+{
+    const char16_t u = c.unicode();
+    if (u < 128) {
+        return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z')
+            || (u >= '0' && u <= '9') || u == '.' || u == '_';
+    }
+    return c.isLetterOrNumber();
+}
+
+int RLexer::scanNumber(QStringView text, int pos)
+{
+    const int n = text.size();
+    int i = pos;
+
+    if (text[i] == u'0' && i + 1 < n && (text[i + 1] == u'x' || text[i + 1] == u'X')) {
+        // Hexadecimal, including hex floats such as 0x1.8p3
+        i += 2;
+        while (i < n && (isHexDigit(text[i]) || text[i] == u'.')) ++i;
+        if (i < n && (text[i] == u'p' || text[i] == u'P')) {
+            int j = i + 1;
+            if (j < n && (text[j] == u'+' || text[j] == u'-')) ++j;
+            if (j < n && isDigit(text[j])) {
+                i = j;
+                while (i < n && isDigit(text[i])) ++i;
+            }
+        }
+    } else {
+        while (i < n && isDigit(text[i])) ++i;
+        if (i < n && text[i] == u'.') {
+            ++i;
+            while (i < n && isDigit(text[i])) ++i;
+        }
+        if (i < n && (text[i] == u'e' || text[i] == u'E')) {
+            int j = i + 1;
+            if (j < n && (text[j] == u'+' || text[j] == u'-')) ++j;
+            if (j < n && isDigit(text[j])) {
+                i = j;
+                while (i < n && isDigit(text[i])) ++i;
+            }
+        }
+    }
+
+    // Integer (1L) and complex (2i) suffixes
+    if (i < n && (text[i] == u'L' || text[i] == u'i')) ++i;
+    return i;
+}
+
+int RLexer::scanQuoted(QStringView text, int pos, QChar quote, bool &terminated)
+{
+    // pos is the first character after the opening quote (or the start of
+    // a continuation line)
+    const int n = text.size();
+    int i = pos;
+    while (i < n) {
+        if (text[i] == u'\\') {
+            i += 2;
+            continue;
+        }
+        if (text[i] == quote) {
+            terminated = true;
+            return i + 1;
+        }
+        ++i;
+    }
+    terminated = false;
+    return n;
+}
+
+int RLexer::makeRawState(QChar quote, QChar closer, int dashes)
+{
+    int closerIndex = 0;
+    if (closer == u']') closerIndex = 1;
+    else if (closer == u'}') closerIndex = 2;
+    return InRawString
+        | (quote == u'\'' ? 1 << 4 : 0)
+        | (closerIndex << 5)
+        | (qMin(dashes, 0x1ff) << 7);
+}
+
+int RLexer::scanRawString(QStringView text, int pos, int &state)
+{
+    // r"(...)", R'[...]', r"---{...}---" and friends. Returns -1 when the
+    // text at pos is not the start of a raw string.
+    const int n = text.size();
+    int i = pos + 1;
+    if (i >= n || (text[i] != u'"' && text[i] != u'\'')) return -1;
+    const QChar quote = text[i++];
+
+    int dashes = 0;
+    while (i < n && text[i] == u'-') {
+        ++dashes;
+        ++i;
+    }
+    if (i >= n) return -1;
+
+    QChar closer;
+    switch (text[i].unicode()) {
+    case '(': closer = u')'; break;
+    case '[': closer = u']'; break;
+    case '{': closer = u'}'; break;
+    default: return -1;
+    }
+    ++i;
+
+    const int rawState = makeRawState(quote, closer, dashes);
+    bool terminated = false;
+    const int end = scanRawBody(text, i, rawState, terminated);
+    state = terminated ? Normal : rawState;
+    return end;
+}
+
+int RLexer::scanRawBody(QStringView text, int pos, int rawState, bool &terminated)
+{
+    static const char16_t closers[] = { u')', u']', u'}' };
+    const QChar quote = (rawState & (1 << 4)) ? u'\'' : u'"';
+    const QChar closer = closers[qBound(0, (rawState >> 5) & 0x3, 2)];
+    const int dashes = (rawState >> 7) & 0x1ff;
+
+    const int n = text.size();
+    for (int i = pos; i < n; ++i) {
+        if (text[i] != closer) continue;
+        int j = i + 1;
+        int k = 0;
+        while (k < dashes && j < n && text[j] == u'-') {
+            ++j;
+            ++k;
+        }
+        if (k == dashes && j < n && text[j] == quote) {
+            terminated = true;
+            return j + 1;
+        }
+    }
+    terminated = false;
+    return n;
+}
+
+int RLexer::scanOperator(QStringView text, int pos)
+{
+    const int n = text.size();
+    auto at = [&](int offset) -> char16_t {
+        return pos + offset < n ? text[pos + offset].unicode() : 0;
+    };
+
+    switch (at(0)) {
+    case '%': {
+        // %%, %/%, %in%, %>% and any other user-defined %op%
+        const int close = text.indexOf(u'%', pos + 1);
+        return close < 0 ? pos + 1 : close + 1;
+    }
+    case '<':
+        if (at(1) == '<' && at(2) == '-') return pos + 3;
+        if (at(1) == '-' || at(1) == '=') return pos + 2;
+        return pos + 1;
+    case '-':
+        if (at(1) == '>' && at(2) == '>') return pos + 3;
+        if (at(1) == '>') return pos + 2;
+        return pos + 1;
+    case '>':
+    case '=':
+    case '!':
+        return at(1) == '=' ? pos + 2 : pos + 1;
+    case '&':
+        return at(1) == '&' ? pos + 2 : pos + 1;
+    case '|':
+        return (at(1) == '|' || at(1) == '>') ? pos + 2 : pos + 1;
+    case ':':
+        if (at(1) == ':' && at(2) == ':') return pos + 3;
+        if (at(1) == ':' || at(1) == '=') return pos + 2;
+        return pos + 1;
+    case '*':
+        return at(1) == '*' ? pos + 2 : pos + 1;
+    case '+':
+    case '/':
+    case '^':
+    case '~':
+    case '?':
+        return pos + 1;
+    default:
+        return pos;
+    }
+}
+
+QVector<RLexer::Token> RLexer::tokenize(QStringView text, int &state)
+{
+    QVector<Token> tokens;
+    const int n = text.size();
+    int i = 0;
+
+    auto followedByParen = [&](int end) {
+        while (end < n && (text[end] == u' ' || text[end] == u'\t')) ++end;
+        return end < n && text[end] == u'(';
+    };
+
+    // Finish a string, raw string or backtick name left open by the
+    // previous line before looking at anything else
+    bool terminated = true;
+    switch (state & StateKindMask) {
+    case InDoubleString:
+        i = scanQuoted(text, 0, u'"', terminated);
+        tokens.append({0, i, String});
+        break;
+    case InSingleString:
+        i = scanQuoted(text, 0, u'\'', terminated);
+        tokens.append({0, i, String});
+        break;
+    case InBacktick:
+        i = scanQuoted(text, 0, u'`', terminated);
+        break;
+    case InRawString:
+        i = scanRawBody(text, 0, state, terminated);
+        tokens.append({0, i, String});
+        break;
+    default:
+        break;
+    }
+    if (!terminated) {
+        return tokens;
+    }
+    state = Normal;
+
+    while (i < n) {
+        const QChar c = text[i];
+        const char16_t u = c.unicode();
+
+        if (u == ' ' || u == '\t') {
+            ++i;
+            continue;
+        }
+
+        if (u == '#') {
+            tokens.append({i, n - i, Comment});
+            break;
+        }
+
+        if (u == '"' || u == '\'') {
+            const int end = scanQuoted(text, i + 1, c, terminated);
+            tokens.append({i, end - i, String});
+            if (!terminated) {
+                state = (u == '"') ? InDoubleString : InSingleString;
+            }
+            i = end;
+            continue;
+        }
+
+        if ((u == 'r' || u == 'R') && i + 1 < n && (text[i + 1] == u'"' || text[i + 1] == u'\'')) {
+            const int end = scanRawString(text, i, state);
+            if (end > 0) {
+                tokens.append({i, end - i, String});
+                i = end;
+                continue;
+            }
+        }
+
+        if (isDigit(c) || (u == '.' && i + 1 < n && isDigit(text[i + 1]))) {
+            const int end = scanNumber(text, i);
+            tokens.append({i, end - i, Number});
+            i = end;
+            continue;
+        }
+
+        if (isIdentifierStart(c)) {
+            int end = i + 1;
+            while (end < n && isIdentifierChar(text[end])) ++end;
+            const QStringView word = text.mid(i, end - i);
+            if (isKeyword(word)) {
+                tokens.append({i, end - i, Keyword});
+            } else if (followedByParen(end)) {
+                tokens.append({i, end - i, Function});
+            }
+            i = end;
+            continue;
+        }
+
+        if (u == '`') {
+            const int end = scanQuoted(text, i + 1, c, terminated);
+            if (!terminated) {
+                state = InBacktick;
+            } else if (followedByParen(end)) {
+                tokens.append({i, end - i, Function});
+            }
+            i = end;
+            continue;
+        }
+
+        if (u == '\\' && i + 1 < n && text[i + 1] == u'(') {
+            // Lambda shorthand: \(x) x + 1
+            tokens.append({i, 1, Keyword});
+            ++i;
+            continue;
+        }
+
+        const int end = scanOperator(text, i);
+        if (end > i) {
+            tokens.append({i, end - i, Operator});
+            i = end;
+            continue;
+        }
+
+        ++i;
+    }
+
+    return tokens;
+}
@@ -0,0 +1,60 @@
+#ifndef RLEXER_H
+#define RLEXER_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// Hand-written single-pass tokenizer for R code. It walks a line once and
+// emits one span per token, so a later rule can never re-color an earlier
+// one (e.g. `#` inside a string or `if` inside a comment).
+class RLexer
+{
+public:
+    enum TokenKind {
+        Keyword,
+        Function,
+        Number,
+        String,
+        Comment,
+        Operator,
+        TokenKindCount
+    };
+
+    struct Token {
+        int start;
+        int length;
+        TokenKind kind;
+    };
+
+    // Lexer state carried from the end of one line to the start of the
+    // next. The low bits hold the kind; raw strings also pack their quote,
+    // closing bracket and dash count so the right terminator is expected.
+    enum State {
+        Normal = 0,
+        InDoubleString = 1,
+        InSingleString = 2,
+        InBacktick = 3,
+        InRawString = 4
+    };
+    static constexpr int StateKindMask = 0x0f;
+    static constexpr int StateBits = 16;
+
+    // Tokenize one line of R code starting in `state`; on return `state`
+    // holds the state at the end of the line. Plain identifiers, whitespace
+    // and punctuation (brackets, commas, semicolons) produce no token.
+    static QVector<Token> tokenize(QStringView text, int &state);
+
+private:
+    static bool isKeyword(QStringView word);
+    static bool isIdentifierStart(QChar c);
+    static bool isIdentifierChar(QChar c);
+    static int scanNumber(QStringView text, int pos);
+    static int scanQuoted(QStringView text, int pos, QChar quote, bool &terminated);
+    static int scanRawString(QStringView text, int pos, int &state);
+    static int scanRawBody(QStringView text, int pos, int rawState, bool &terminated);
+    static int scanOperator(QStringView text, int pos);
+    static int makeRawState(QChar quote, QChar closer, int dashes);
+};
+
+#endif // RLEXER_H
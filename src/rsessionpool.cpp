@@ -0,0 +1,63 @@
+#include "rsessionpool.h"
+#include "terminalwidget.h"
+#include "thememanager.h"
+#include <QSettings>
+#include <QTimer>
+
+RSessionPool::RSessionPool(QObject *parent)
+    : QObject(parent)
+{
+    QSettings settings("Q", "Q");
+    poolSize = qBound(0, settings.value("r/poolSize", 1).toInt(), 8);
+
+    refillTimer = new QTimer(this);
+    refillTimer->setSingleShot(true);
+    refillTimer->setInterval(RefillDelay);
+    connect(refillTimer, &QTimer::timeout, this, &RSessionPool::refill);
+    refillTimer->start();
+}
+
+RSessionPool::~RSessionPool()
+{
+    // Pooled consoles have no parent; their R processes end with them
+    qDeleteAll(sessions);
+}
+
+TerminalWidget *RSessionPool::take(QWidget *parent)
+{
+    TerminalWidget *session = nullptr;
+    if (!sessions.isEmpty()) {
+        session = sessions.takeFirst();
+        disconnect(session, nullptr, this, nullptr);
+        session->setParent(parent);
+        // The theme may have changed since the console was started
+        session->setTheme(ThemeManager::instance().currentTheme());
+    } else {
+        session = new TerminalWidget("R", parent);
+    }
+    refillTimer->start();
+    return session;
+}
+
+void RSessionPool::refill()
+{
+    // One at a time, so a large pool does not start every R at once
+    if (sessions.size() >= poolSize) return;
+
+    TerminalWidget *session = new TerminalWidget("R");
+    // A pooled R that exits (a broken profile, say) is of no use
+    connect(session, &QTermWidget::finished, this, [this, session]() {
+        discard(session);
+    });
+    sessions.append(session);
+
+    if (sessions.size() < poolSize) {
+        refillTimer->start();
+    }
+}
+
+void RSessionPool::discard(TerminalWidget *session)
+{
+    sessions.removeOne(session);
+    session->deleteLater();
+}
@@ -0,0 +1,43 @@
+#ifndef RSESSIONPOOL_H
+#define RSESSIONPOOL_H
+
+#include <QObject>
+#include <QList>
+
+class QTimer;
+class QWidget;
+class TerminalWidget;
+
+// R consoles started ahead of time, so a new console is usable as soon as
+// it is asked for instead of after R has started and sourced its profile,
+// qide and any preloaded packages. The pooled consoles are hidden widgets
+// with no parent; take() hands one over and starts a replacement once
+// things have settled. The pool size comes from the r/poolSize setting
+// (0 disables it).
+class RSessionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RSessionPool(QObject *parent = nullptr);
+    ~RSessionPool();
+
+    // A running R console reparented to parent, from the pool if one is
+    // ready, started now otherwise
+    TerminalWidget *take(QWidget *parent);
+    int readyCount() const { return sessions.size(); }
+
+private:
+    // Gives the console just taken time to start before R competes with
+    // it for the CPU
+    static constexpr int RefillDelay = 2000;
+
+    void refill();
+    void discard(TerminalWidget *session);
+
+    QList<TerminalWidget*> sessions;
+    QTimer *refillTimer;
+    int poolSize;
+};
+
+#endif // RSESSIONPOOL_H
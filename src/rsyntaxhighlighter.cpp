@@ -1,89 +1,329 @@
 #include "rsyntaxhighlighter.h"
+#include <QSettings>
+#include <QTextDocument>
+#include <QTimer>
+
+namespace {
+// Blocks lexed synchronously per event-loop turn on a large document
+// before the rest is handed to the background pass
+constexpr int SyncBlockBudget = 2000;
+// Blocks re-colored per timer tick when applying background results or
+// a new theme
+constexpr int ApplyBlocksPerTick = 1000;
+}
 
 RSyntaxHighlighter::RSyntaxHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
 {
+    // Documents with at least this many lines are tokenized on a worker
+    // thread; 0 disables background highlighting
+    QSettings settings("Q", "Q");
+    m_backgroundThreshold = settings.value("editor/backgroundHighlightLines", 20000).toInt();
+
+    m_passTimer = new QTimer(this);
+    m_passTimer->setSingleShot(true);
+    m_passTimer->setInterval(150);
+    connect(m_passTimer, &QTimer::timeout, this, &RSyntaxHighlighter::startBackgroundPass);
+
+    m_applyTimer = new QTimer(this);
+    m_applyTimer->setInterval(0);
+    connect(m_applyTimer, &QTimer::timeout, this, &RSyntaxHighlighter::applyPendingBlocks);
+
     // Initialize with current theme
     setTheme(ThemeManager::instance().currentTheme());
 }
 
+RSyntaxHighlighter::~RSyntaxHighlighter()
+{
+    if (m_pass) {
+        m_pass->cancelled = true;
+    }
+    if (m_worker) {
+        m_worker->wait();
+    }
+}
+
 void RSyntaxHighlighter::setTheme(const EditorTheme &theme)
 {
-    highlightingRules.clear();
-    
-    HighlightingRule rule;
-    
     // Keywords
+    QTextCharFormat keywordFormat;
     keywordFormat.setForeground(theme.keyword);
     keywordFormat.setFontWeight(QFont::Bold);
-    
-    QStringList keywordPatterns = {
-        "\\bif\\b", "\\belse\\b", "\\bfor\\b", "\\bwhile\\b", "\\brepeat\\b",
-        "\\bfunction\\b", "\\breturn\\b", "\\bnext\\b", "\\bbreak\\b",
-        "\\bTRUE\\b", "\\bFALSE\\b", "\\bNULL\\b", "\\bNA\\b", "\\bNaN\\b",
-        "\\bInf\\b", "\\bin\\b"
-    };
-    
-    for (const QString &pattern : keywordPatterns) {
-        rule.pattern = QRegularExpression(pattern);
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
-    }
-    
-    // Functions (word followed by opening parenthesis)
+    formats[RLexer::Keyword] = keywordFormat;
+
+    // Functions (identifier followed by opening parenthesis)
+    QTextCharFormat functionFormat;
     functionFormat.setForeground(theme.function);
     functionFormat.setFontItalic(false);
-    rule.pattern = QRegularExpression("\\b[A-Za-z0-9_\\.]+(?=\\s*\\()");
-    rule.format = functionFormat;
-    highlightingRules.append(rule);
-    
+    formats[RLexer::Function] = functionFormat;
+
     // Numbers
+    QTextCharFormat numberFormat;
     numberFormat.setForeground(theme.number);
-    rule.pattern = QRegularExpression("\\b[0-9]+\\.?[0-9]*([eE][-+]?[0-9]+)?\\b");
-    rule.format = numberFormat;
-    highlightingRules.append(rule);
-    
+    formats[RLexer::Number] = numberFormat;
+
     // Operators
+    QTextCharFormat operatorFormat;
     operatorFormat.setForeground(theme.operator_);
-    QStringList operatorPatterns = {
-        "\\+", "-", "\\*", "/", "\\^", "%%", "%/%",
-        "==", "!=", "<", ">", "<=", ">=",
-        "\\&", "\\|", "!", "&&", "\\|\\|",
-        "<-", "<<-", "->", "->>", "=", "~"
-    };
-    
-    for (const QString &pattern : operatorPatterns) {
-        rule.pattern = QRegularExpression(pattern);
-        rule.format = operatorFormat;
-        highlightingRules.append(rule);
-    }
-    
-    // Strings (double quotes)
+    formats[RLexer::Operator] = operatorFormat;
+
+    // Strings (single, double and raw)
+    QTextCharFormat stringFormat;
     stringFormat.setForeground(theme.string);
-    rule.pattern = QRegularExpression("\"[^\"\\\\]*(\\\\.[^\"\\\\]*)*\"");
-    rule.format = stringFormat;
-    highlightingRules.append(rule);
-    
-    // Strings (single quotes)
-    rule.pattern = QRegularExpression("'[^'\\\\]*(\\\\.[^'\\\\]*)*'");
-    rule.format = stringFormat;
-    highlightingRules.append(rule);
-    
+    formats[RLexer::String] = stringFormat;
+
     // Comments
+    QTextCharFormat commentFormat;
     commentFormat.setForeground(theme.comment);
     commentFormat.setFontItalic(true);
-    rule.pattern = QRegularExpression("#[^\n]*");
-    rule.format = commentFormat;
-    highlightingRules.append(rule);
+    formats[RLexer::Comment] = commentFormat;
+}
+
+void RSyntaxHighlighter::setMarkdownMode(bool enabled)
+{
+    if (m_markdownMode == enabled) return;
+    m_markdownMode = enabled;
+    m_result.reset();
+    rehighlight();
+}
+
+void RSyntaxHighlighter::setVisibleBlockRange(int first, int last)
+{
+    m_firstVisible = qMax(0, first);
+    m_lastVisible = qMax(m_firstVisible, last);
+}
+
+void RSyntaxHighlighter::rehighlightVisible()
+{
+    if (!document()) return;
+
+    // Block states are unchanged by a format change, so each
+    // rehighlightBlock stops at its own block
+    QTextBlock block = document()->findBlockByNumber(m_firstVisible);
+    for (int i = m_firstVisible; i <= m_lastVisible && block.isValid(); ++i) {
+        rehighlightBlock(block);
+        block = block.next();
+    }
+}
+
+void RSyntaxHighlighter::rehighlightProgressively()
+{
+    if (!document()) return;
+
+    const int count = qMax(document()->blockCount(),
+                           m_result ? int(m_result->hashes.size()) : 0);
+    m_applied = QBitArray(count);
+    m_applyAbove = m_firstVisible - 1;
+    m_applyBelow = m_firstVisible;
+    // First tick runs now so the visible blocks are recolored immediately;
+    // it stops the timer itself if that already covered the document
+    m_applyTimer->start();
+    applyPendingBlocks();
+}
+
+bool RSyntaxHighlighter::isChunkFence(QStringView text, bool *opensRChunk)
+{
+    const QStringView line = text.trimmed();
+    if (!line.startsWith(QLatin1String("```"))) return false;
+
+    if (opensRChunk) {
+        int i = 3;
+        while (i < line.size() && line[i] == u'`') ++i;
+        while (i < line.size() && line[i].isSpace()) ++i;
+        *opensRChunk = i + 1 < line.size() && line[i] == u'{'
+            && (line[i + 1] == u'r' || line[i + 1] == u'R')
+            && (i + 2 >= line.size() || line[i + 2] == u'}' || line[i + 2] == u','
+                || line[i + 2].isSpace());
+    }
+    return true;
+}
+
+int RSyntaxHighlighter::lexLine(QStringView text, int previousState, bool markdown,
+                                QVector<RLexer::Token> &tokens)
+{
+    int lexerState = previousState & LexerStateMask;
+
+    if (!markdown) {
+        tokens = RLexer::tokenize(text, lexerState);
+        return lexerState;
+    }
+
+    const RLexer::Token fence = {0, int(text.size()), RLexer::Comment};
+    tokens.clear();
+
+    if (previousState & (RmdChunk | RmdForeignChunk)) {
+        if (isChunkFence(text, nullptr)) {
+            tokens.append(fence);
+            return 0;
+        }
+        if (previousState & RmdForeignChunk) {
+            return RmdForeignChunk;
+        }
+        tokens = RLexer::tokenize(text, lexerState);
+        return RmdChunk | lexerState;
+    }
+
+    bool opensRChunk = false;
+    if (isChunkFence(text, &opensRChunk)) {
+        tokens.append(fence);
+        return opensRChunk ? RmdChunk : RmdForeignChunk;
+    }
+    return 0;
 }
 
 void RSyntaxHighlighter::highlightBlock(const QString &text)
 {
-    for (const HighlightingRule &rule : highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+    // The state stored on each block lets QSyntaxHighlighter stop
+    // re-highlighting at the first block whose end state is unchanged, so
+    // an edit only costs the lines it actually affects.
+    if (backgroundEligible()) {
+        if (applyCachedBlock(text)) {
+            return;
         }
+        if (m_backgroundPending || m_syncBlocksThisTurn >= SyncBlockBudget) {
+            // Leave the block plain for now; the background pass colors it
+            scheduleBackgroundPass();
+            setCurrentBlockState(qMax(0, previousBlockState()));
+            return;
+        }
+        if (m_syncBlocksThisTurn++ == 0) {
+            QTimer::singleShot(0, this, [this]() { m_syncBlocksThisTurn = 0; });
+        }
+    } else if (m_result) {
+        m_result.reset();
+    }
+
+    // Single linear scan: every character belongs to at most one token
+    QVector<RLexer::Token> tokens;
+    const int state = lexLine(text, qMax(0, previousBlockState()), m_markdownMode, tokens);
+    for (const RLexer::Token &token : tokens) {
+        setFormat(token.start, token.length, formats[token.kind]);
+    }
+    setCurrentBlockState(state);
+}
+
+bool RSyntaxHighlighter::backgroundEligible() const
+{
+    return m_backgroundThreshold > 0 && document()
+        && document()->blockCount() >= m_backgroundThreshold;
+}
+
+bool RSyntaxHighlighter::applyCachedBlock(const QString &text)
+{
+    if (!m_result) return false;
+
+    const int n = currentBlock().blockNumber();
+    if (n < 0 || n >= m_result->hashes.size() || m_result->hashes[n] != qHash(text)) {
+        return false;
+    }
+
+    // The start state must agree with the previous block, unless that block
+    // has not been colored from these results yet (visible-first order)
+    if (n > 0 && m_applied.testBit(n - 1)
+            && qMax(0, previousBlockState()) != m_result->endStates[n - 1]) {
+        return false;
+    }
+
+    for (const RLexer::Token &token : std::as_const(m_result->tokens[n])) {
+        setFormat(token.start, token.length, formats[token.kind]);
+    }
+    setCurrentBlockState(m_result->endStates[n]);
+    m_applied.setBit(n);
+    return true;
+}
+
+void RSyntaxHighlighter::scheduleBackgroundPass()
+{
+    // Restarting the timer coalesces bursts (chunked loads, large pastes)
+    // into a single pass once the document settles
+    m_backgroundPending = true;
+    m_passTimer->start();
+}
+
+void RSyntaxHighlighter::startBackgroundPass()
+{
+    if (m_pass) {
+        m_pass->cancelled = true;
+    }
+
+    auto pass = std::make_shared<BackgroundPass>();
+    pass->text = document()->toPlainText();
+    pass->markdown = m_markdownMode;
+    m_pass = pass;
+    const int generation = ++m_generation;
+
+    QThread *worker = QThread::create([pass]() {
+        const QStringView all(pass->text);
+        QVector<RLexer::Token> tokens;
+        int state = 0;
+        qsizetype start = 0;
+        while (!pass->cancelled) {
+            const qsizetype end = all.indexOf(u'\n', start);
+            const QStringView line = all.mid(start, (end < 0 ? all.size() : end) - start);
+            state = lexLine(line, state, pass->markdown, tokens);
+            pass->tokens.append(tokens);
+            pass->endStates.append(state);
+            pass->hashes.append(qHash(line));
+            if (end < 0) break;
+            start = end + 1;
+        }
+    });
+
+    connect(worker, &QThread::finished, this, [this, pass, generation]() {
+        if (generation != m_generation || pass->cancelled) return;
+        m_result = pass;
+        m_pass.reset();
+        m_backgroundPending = false;
+        m_applied = QBitArray(int(m_result->hashes.size()));
+        m_applyAbove = m_firstVisible - 1;
+        m_applyBelow = m_firstVisible;
+        m_applyTimer->start();
+    });
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+
+    m_worker = worker;
+    worker->start(QThread::LowPriority);
+}
+
+void RSyntaxHighlighter::applyBlock(int blockNumber)
+{
+    if (m_applied.testBit(blockNumber)) return;
+
+    const QTextBlock block = document()->findBlockByNumber(blockNumber);
+    if (block.isValid()) {
+        rehighlightBlock(block);
+    }
+    m_applied.setBit(blockNumber);
+}
+
+void RSyntaxHighlighter::applyPendingBlocks()
+{
+    if (!document()) {
+        m_applyTimer->stop();
+        return;
+    }
+
+    const int count = qMin(int(m_applied.size()), document()->blockCount());
+
+    // Whatever is on screen right now always goes first
+    for (int i = m_firstVisible; i <= m_lastVisible && i < count; ++i) {
+        applyBlock(i);
+    }
+
+    // Then spread outward from where the pass started
+    int budget = ApplyBlocksPerTick;
+    while (budget > 0 && (m_applyBelow < count || m_applyAbove >= 0)) {
+        if (m_applyBelow < count) {
+            applyBlock(m_applyBelow++);
+            --budget;
+        }
+        if (m_applyAbove >= 0) {
+            applyBlock(m_applyAbove--);
+            --budget;
+        }
+    }
+
+    if (m_applyBelow >= count && m_applyAbove < 0) {
+        m_applyTimer->stop();
     }
 }
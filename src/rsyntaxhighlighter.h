@@ -2,34 +2,100 @@
 #define RSYNTAXHIGHLIGHTER_H
 
 #include <QSyntaxHighlighter>
-#include <QRegularExpression>
 #include <QTextCharFormat>
+#include <QBitArray>
+#include <QPointer>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include "rlexer.h"
 #include "thememanager.h"
 
+class QTimer;
+
 class RSyntaxHighlighter : public QSyntaxHighlighter
 {
     Q_OBJECT
 
 public:
     explicit RSyntaxHighlighter(QTextDocument *parent = nullptr);
+    ~RSyntaxHighlighter();
     void setTheme(const EditorTheme &theme);
 
+    // R Markdown / Quarto documents: only code inside ```{r} chunks is
+    // lexed as R, everything else is left as prose
+    void setMarkdownMode(bool enabled);
+    bool markdownMode() const { return m_markdownMode; }
+
+    // Blocks currently on screen; background results are applied to these
+    // first and then progressively outward
+    void setVisibleBlockRange(int first, int last);
+
+    // Re-color after a format change (e.g. a theme switch) without the
+    // blocking full rehighlight(): only the visible blocks, or the visible
+    // blocks now and the rest progressively from the event loop
+    void rehighlightVisible();
+    void rehighlightProgressively();
+
 protected:
     void highlightBlock(const QString &text) override;
 
+private slots:
+    void startBackgroundPass();
+    void applyPendingBlocks();
+
 private:
-    struct HighlightingRule {
-        QRegularExpression pattern;
-        QTextCharFormat format;
+    // Block state layout: the low RLexer::StateBits hold the lexer state,
+    // the bits above them track Rmd chunk nesting
+    enum BlockFlag {
+        RmdChunk = 1 << RLexer::StateBits,
+        RmdForeignChunk = 2 << RLexer::StateBits
+    };
+    static constexpr int LexerStateMask = (1 << RLexer::StateBits) - 1;
+
+    // Tokens and end state of one line; shared by highlightBlock and the
+    // background worker so both produce identical results
+    static int lexLine(QStringView text, int previousState, bool markdown,
+                       QVector<RLexer::Token> &tokens);
+    static bool isChunkFence(QStringView text, bool *opensRChunk);
+
+    // Snapshot tokenization produced on a worker thread for documents above
+    // the background threshold. Entries are validated against the block
+    // text hash and start state before use, so edits made while the pass
+    // was running simply fall back to synchronous lexing.
+    struct BackgroundPass {
+        QString text;
+        bool markdown = false;
+        std::atomic<bool> cancelled{false};
+        QVector<QVector<RLexer::Token>> tokens;
+        QVector<int> endStates;
+        QVector<size_t> hashes;
     };
-    QVector<HighlightingRule> highlightingRules;
-    
-    QTextCharFormat keywordFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat commentFormat;
-    QTextCharFormat stringFormat;
-    QTextCharFormat numberFormat;
-    QTextCharFormat operatorFormat;
+
+    bool backgroundEligible() const;
+    bool applyCachedBlock(const QString &text);
+    void scheduleBackgroundPass();
+    void applyBlock(int blockNumber);
+
+    bool m_markdownMode = false;
+
+    int m_backgroundThreshold;
+    bool m_backgroundPending = false;
+    int m_syncBlocksThisTurn = 0;
+    int m_generation = 0;
+    std::shared_ptr<BackgroundPass> m_pass;
+    std::shared_ptr<BackgroundPass> m_result;
+    QPointer<QThread> m_worker;
+    QTimer *m_passTimer;
+    QTimer *m_applyTimer;
+    QBitArray m_applied;
+    int m_applyAbove = -1;
+    int m_applyBelow = 0;
+    int m_firstVisible = 0;
+    int m_lastVisible = 0;
+
+    // One format per lexer token kind, indexed by RLexer::TokenKind
+    QTextCharFormat formats[RLexer::TokenKindCount];
 };
 
 #endif // RSYNTAXHIGHLIGHTER_H
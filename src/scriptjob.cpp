@@ -0,0 +1,262 @@
+#include "scriptjob.h"
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+
+namespace {
+
+// Lines starting with this byte on stderr are progress reports from the
+// wrapper, not output of the script
+const char ProgressMarker = '\x1e';
+
+QString rString(QString value)
+{
+    value.replace('\\', '/').replace('\'', "\\'");
+    return "'" + value + "'";
+}
+
+} // namespace
+
+ScriptJob::ScriptJob(int id, const QString &script, const QString &workingDirectory,
+                     const QString &tempDir, const Parameters &parameters, QObject *parent)
+    : QObject(parent)
+    , jobId(id)
+    , scriptPath(script)
+    , workingDirectory(workingDirectory)
+    , tempDir(tempDir)
+    , params(parameters)
+{
+    process = new QProcess(this);
+    process->setWorkingDirectory(workingDirectory);
+
+    sampleTimer = new QTimer(this);
+    sampleTimer->setInterval(SampleInterval);
+    connect(sampleTimer, &QTimer::timeout, this, &ScriptJob::sampleMemory);
+
+    connect(process, &QProcess::readyReadStandardOutput, this, [this]() {
+        appendOutput(outputDecoder.decode(process->readAllStandardOutput()));
+    });
+    connect(process, &QProcess::readyReadStandardError, this, &ScriptJob::readStandardError);
+    connect(process, &QProcess::finished, this, &ScriptJob::onFinished);
+    connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        // Other errors are followed by finished()
+        if (error != QProcess::FailedToStart) return;
+        appendOutput(tr("Cannot start Rscript: %1\n").arg(process->errorString()));
+        elapsedAtEnd = 0;
+        jobStatus = Failed;
+        emit changed();
+        emit finished();
+    });
+}
+
+ScriptJob::~ScriptJob()
+{
+    if (process->state() != QProcess::NotRunning) {
+        disconnect(process, nullptr, this, nullptr);
+        process->kill();
+        process->waitForFinished(1000);
+    }
+}
+
+QString ScriptJob::statusText(Status status)
+{
+    switch (status) {
+    case Queued: return tr("Queued");
+    case Running: return tr("Running");
+    case Succeeded: return tr("Done");
+    case Failed: return tr("Failed");
+    case Stopped: return tr("Stopped");
+    }
+    return QString();
+}
+
+qint64 ScriptJob::elapsed() const
+{
+    if (elapsedAtEnd >= 0) return elapsedAtEnd;
+    return timer.isValid() ? timer.elapsed() : 0;
+}
+
+QString ScriptJob::resultFile() const
+{
+    return QDir(tempDir).filePath(QString("job-%1.rds").arg(jobId));
+}
+
+void ScriptJob::start()
+{
+    if (jobStatus != Queued) return;
+
+    const QString wrapper = QDir(tempDir).filePath(QString("job-%1.R").arg(jobId));
+    if (!writeWrapper(wrapper)) {
+        appendOutput(tr("Cannot write %1\n").arg(wrapper));
+        jobStatus = Failed;
+        elapsedAtEnd = 0;
+        emit changed();
+        emit finished();
+        return;
+    }
+
+    QString rscript = QStandardPaths::findExecutable("Rscript");
+    if (rscript.isEmpty()) {
+        rscript = "Rscript";
+    }
+
+    jobStatus = Running;
+    timer.start();
+    sampleTimer->start();
+    process->start(rscript, {"--no-save", "--no-restore", wrapper});
+    emit changed();
+}
+
+void ScriptJob::stop()
+{
+    if (jobStatus == Queued) {
+        jobStatus = Stopped;
+        elapsedAtEnd = 0;
+        emit changed();
+        emit finished();
+        return;
+    }
+    if (process->state() == QProcess::NotRunning) return;
+
+    stopping = true;
+    process->terminate();
+    // R may not get to its signal handler while in compiled code
+    QTimer::singleShot(StopTimeout, process, [this]() {
+        if (process->state() != QProcess::NotRunning) {
+            process->kill();
+        }
+    });
+}
+
+bool ScriptJob::writeWrapper(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+
+    // Evaluating top-level expressions one at a time is what lets the job
+    // report progress; visible values are printed as source() would
+    QTextStream out(&file);
+    // The kernel's high-water mark as R exits: polling from Q misses
+    // short jobs and whatever happens after the last sample. Rscript
+    // quits on an error without running on.exit(), but exit finalizers
+    // run either way, and the global environment is never collected.
+    out << "reg.finalizer(.GlobalEnv, function(e) {\n";
+    out << "  status <- tryCatch(readLines('/proc/self/status'), error = function(e) character())\n";
+    out << "  hwm <- grep('^VmHWM:', status, value = TRUE)\n";
+    out << "  if (length(hwm)) cat(sprintf('\\036peak %s\\n', gsub('[^0-9]', '', hwm[[1L]])), file = stderr())\n";
+    out << "}, onexit = TRUE)\n";
+    for (const auto &parameter : params) {
+        out << parameter.first << " <- " << parameter.second << "\n";
+    }
+    out << "local({\n";
+    out << "  exprs <- parse(" << rString(scriptPath) << ", keep.source = FALSE, encoding = 'UTF-8')\n";
+    out << "  n <- length(exprs)\n";
+    out << "  cat(sprintf('\\036progress 0 %d\\n', n), file = stderr())\n";
+    out << "  for (i in seq_len(n)) {\n";
+    out << "    res <- withVisible(eval(exprs[[i]], envir = .GlobalEnv))\n";
+    out << "    if (res$visible) print(res$value)\n";
+    out << "    flush(stdout())\n";
+    out << "    cat(sprintf('\\036progress %d %d\\n', i, n), file = stderr())\n";
+    out << "  }\n";
+    out << "})\n";
+    out << "saveRDS(mget(ls(.GlobalEnv), envir = .GlobalEnv), " << rString(resultFile())
+        << ", compress = FALSE)\n";
+    return out.status() == QTextStream::Ok;
+}
+
+void ScriptJob::appendOutput(const QString &output)
+{
+    if (output.isEmpty()) return;
+    text += output;
+    if (text.size() > MaxOutputChars) {
+        text.remove(0, text.size() - MaxOutputChars);
+    }
+    emit outputAdded(output);
+}
+
+void ScriptJob::readStandardError()
+{
+    errorBuffer += process->readAllStandardError();
+
+    // Progress reports are whole lines; anything else is passed on as it
+    // arrives so messages and errors show up in order
+    QString output;
+    qsizetype start = 0;
+    qsizetype end;
+    while ((end = errorBuffer.indexOf('\n', start)) >= 0) {
+        const QByteArray line = errorBuffer.mid(start, end - start + 1);
+        start = end + 1;
+        if (line.startsWith(ProgressMarker)) {
+            const QList<QByteArray> fields = line.trimmed().split(' ');
+            if (fields.size() == 3 && fields.at(0).endsWith("progress")) {
+                done = fields.at(1).toInt();
+                total = fields.at(2).toInt();
+                emit changed();
+            } else if (fields.size() == 2 && fields.at(0).endsWith("peak")) {
+                // VmHWM in kB, reported by the wrapper as R exits
+                const qint64 bytes = fields.at(1).toLongLong() * 1024;
+                if (bytes > peakRss) {
+                    peakRss = bytes;
+                    emit changed();
+                }
+            }
+        } else {
+            output += errorDecoder.decode(line);
+        }
+    }
+    errorBuffer.remove(0, start);
+    // A partial line that cannot be a progress report need not wait
+    if (!errorBuffer.isEmpty() && !errorBuffer.startsWith(ProgressMarker)) {
+        output += errorDecoder.decode(errorBuffer);
+        errorBuffer.clear();
+    }
+    appendOutput(output);
+}
+
+void ScriptJob::sampleMemory()
+{
+    // VmHWM is the kernel's own high-water mark of the resident set, so
+    // sampling cannot miss a short peak between two reads. This only
+    // keeps the display live; the wrapper reports the final value.
+    QFile status(QString("/proc/%1/status").arg(process->processId()));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) return;
+
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith("VmHWM:")) {
+            const qint64 bytes = line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+            if (bytes > peakRss) {
+                peakRss = bytes;
+                emit changed();
+            }
+            break;
+        }
+    }
+}
+
+void ScriptJob::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    sampleTimer->stop();
+    elapsedAtEnd = timer.elapsed();
+
+    appendOutput(outputDecoder.decode(process->readAllStandardOutput()));
+    readStandardError();
+    if (!errorBuffer.isEmpty()) {
+        appendOutput(errorDecoder.decode(errorBuffer));
+        errorBuffer.clear();
+    }
+
+    if (stopping) {
+        jobStatus = Stopped;
+    } else if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+        jobStatus = Succeeded;
+    } else {
+        jobStatus = Failed;
+    }
+    emit changed();
+    emit finished();
+}
@@ -0,0 +1,99 @@
+#ifndef SCRIPTJOB_H
+#define SCRIPTJOB_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QProcess>
+#include <QStringDecoder>
+
+class QTimer;
+
+// One R script run in its own Rscript process, away from the console.
+// The script is evaluated expression by expression by a small wrapper
+// that reports progress and, as it exits, peak memory on stderr and, on
+// success, saves the objects the script created to an uncompressed RDS
+// file for importing later.
+class ScriptJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Status {
+        Queued,
+        Running,
+        Succeeded,
+        Failed,
+        Stopped
+    };
+
+    // Variables assigned in the job's global environment before the
+    // script runs: name, R expression
+    using Parameters = QList<QPair<QString, QString>>;
+
+    // Wrapper and result files go to tempDir, named after id
+    ScriptJob(int id, const QString &script, const QString &workingDirectory,
+              const QString &tempDir, const Parameters &parameters = Parameters(),
+              QObject *parent = nullptr);
+    ~ScriptJob();
+
+    void start();
+    // Stops a running job; a queued one is cancelled without starting
+    void stop();
+
+    int id() const { return jobId; }
+    QString script() const { return scriptPath; }
+    Parameters parameters() const { return params; }
+    Status status() const { return jobStatus; }
+    static QString statusText(Status status);
+    QString output() const { return text; }
+    // Top-level expressions evaluated so far, out of steps()
+    int progress() const { return done; }
+    int steps() const { return total; }
+    qint64 elapsed() const;
+    // Peak resident set size in bytes, 0 where it cannot be read
+    qint64 peakMemory() const { return peakRss; }
+    // Objects the script left in its global environment; only written
+    // when it succeeded
+    QString resultFile() const;
+
+signals:
+    void outputAdded(const QString &text);
+    // Status, progress or memory changed
+    void changed();
+    void finished();
+
+private:
+    // Output kept per job; older text is dropped beyond this
+    static constexpr int MaxOutputChars = 4 * 1024 * 1024;
+    static constexpr int SampleInterval = 1000;
+    static constexpr int StopTimeout = 3000;
+
+    bool writeWrapper(const QString &path);
+    void appendOutput(const QString &output);
+    void readStandardError();
+    void sampleMemory();
+    void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+    int jobId;
+    QString scriptPath;
+    QString workingDirectory;
+    QString tempDir;
+    Parameters params;
+    QProcess *process;
+    QTimer *sampleTimer;
+    QElapsedTimer timer;
+    qint64 elapsedAtEnd = -1;
+    Status jobStatus = Queued;
+    bool stopping = false;
+    QString text;
+    QByteArray errorBuffer;
+    QStringDecoder outputDecoder{QStringDecoder::Utf8};
+    QStringDecoder errorDecoder{QStringDecoder::Utf8};
+    int done = 0;
+    int total = 0;
+    qint64 peakRss = 0;
+};
+
+#endif // SCRIPTJOB_H
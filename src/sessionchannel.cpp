@@ -0,0 +1,460 @@
+#include "sessionchannel.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QCoreApplication>
+#include <QtEndian>
+#include <QDebug>
+#include <climits>
+
+namespace {
+
+const int FrameHeaderSize = 5;
+
+bool readString(QDataStream &in, QString &out)
+{
+    quint32 length = 0;
+    in >> length;
+    if (in.status() != QDataStream::Ok || length > quint32(in.device()->bytesAvailable())) {
+        return false;
+    }
+    QByteArray bytes(int(length), Qt::Uninitialized);
+    if (in.readRawData(bytes.data(), int(length)) != int(length)) {
+        return false;
+    }
+    out = QString::fromUtf8(bytes);
+    return true;
+}
+
+void writeString(QDataStream &out, const QString &value)
+{
+    const QByteArray bytes = value.toUtf8();
+    out << quint32(bytes.size());
+    out.writeRawData(bytes.constData(), int(bytes.size()));
+}
+
+} // namespace
+
+SessionChannel::SessionChannel(QObject *parent)
+    : QObject(parent)
+{
+    // The pid keeps concurrent Q instances apart, the counter keeps the
+    // R sessions of one instance apart
+    static int sessionCounter = 0;
+    const QString name = QString("q-%1-%2")
+        .arg(QCoreApplication::applicationPid())
+        .arg(++sessionCounter);
+
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    QLocalServer::removeServer(name);
+    if (!server->listen(name)) {
+        qWarning() << "Cannot open R session channel" << name << ":" << server->errorString();
+    }
+
+    connect(server, &QLocalServer::newConnection, this, &SessionChannel::onNewConnection);
+}
+
+SessionChannel::~SessionChannel()
+{
+    server->close();
+}
+
+QString SessionChannel::address() const
+{
+    return server->isListening() ? server->fullServerName() : QString();
+}
+
+bool SessionChannel::send(quint8 type, const QByteArray &payload)
+{
+    if (!client) return false;
+
+    char header[FrameHeaderSize];
+    qToLittleEndian<quint32>(quint32(payload.size()), header);
+    header[4] = char(type);
+    client->write(header, FrameHeaderSize);
+    client->write(payload);
+    return true;
+}
+
+bool SessionChannel::requestChildren(quint32 requestId, const QStringList &path, quint32 offset, quint32 count)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << requestId << quint32(path.size());
+    for (const QString &element : path) {
+        writeString(out, element);
+    }
+    out << offset << count;
+    return send(ChildrenRequestMessage, payload);
+}
+
+bool SessionChannel::queryTable(quint32 viewId, quint32 generation, const QStringList &path,
+                                int sortColumn, bool descending, const QString &filter)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << viewId << generation << quint32(path.size());
+    for (const QString &element : path) {
+        writeString(out, element);
+    }
+    out << qint32(sortColumn) << quint8(descending ? 1 : 0);
+    writeString(out, filter);
+    return send(TableQueryMessage, payload);
+}
+
+bool SessionChannel::requestTableRows(quint32 viewId, quint32 generation, double firstRow, quint32 count,
+                                      quint32 firstColumn, quint32 columnCount)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    out << viewId << generation << firstRow << count << firstColumn << columnCount
+        << quint8(SharedColumns::isSupported() ? 1 : 0);
+    return send(TableRowsRequestMessage, payload);
+}
+
+bool SessionChannel::closeTable(quint32 viewId)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << viewId;
+    return send(TableCloseMessage, payload);
+}
+
+quint32 SessionChannel::evaluate(const QString &code)
+{
+    if (!client) return 0;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    // Skip 0, which means "not sent"
+    if (++lastEvalId == 0) ++lastEvalId;
+    out << lastEvalId;
+    writeString(out, code);
+    send(EvalMessage, payload);
+    return lastEvalId;
+}
+
+void SessionChannel::onNewConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        // Only one R process talks to a channel; a new connection (e.g.
+        // qide re-initialised) replaces the old one
+        if (client) {
+            client->disconnect(this);
+            client->abort();
+            client->deleteLater();
+        }
+        client = socket;
+        buffer.clear();
+
+        connect(client, &QLocalSocket::readyRead, this, &SessionChannel::onReadyRead);
+        connect(client, &QLocalSocket::disconnected, this, [this, socket]() {
+            if (client != socket) return;
+            client = nullptr;
+            buffer.clear();
+            socket->deleteLater();
+            emit disconnected();
+        });
+        emit connected();
+    }
+}
+
+void SessionChannel::onReadyRead()
+{
+    buffer.append(client->readAll());
+
+    qsizetype offset = 0;
+    while (buffer.size() - offset >= FrameHeaderSize) {
+        const quint32 length = qFromLittleEndian<quint32>(buffer.constData() + offset);
+        if (length > MaxFrameSize) {
+            qWarning() << "R session channel: oversized frame, dropping connection";
+            buffer.clear();
+            client->abort();
+            return;
+        }
+        if (buffer.size() - offset < FrameHeaderSize + qsizetype(length)) {
+            break;
+        }
+        const quint8 type = quint8(buffer.at(offset + 4));
+        const QByteArray payload = buffer.mid(offset + FrameHeaderSize, length);
+        offset += FrameHeaderSize + length;
+        dispatch(type, payload);
+    }
+    buffer.remove(0, offset);
+}
+
+void SessionChannel::dispatch(quint8 type, const QByteArray &payload)
+{
+    emit messageReceived(type, payload);
+
+    switch (type) {
+    case EnvironmentMessage: {
+        EnvironmentSnapshot snapshot;
+        if (decodeEnvironment(payload, snapshot)) {
+            emit environmentReceived(snapshot);
+        } else {
+            qWarning() << "R session channel: malformed environment message";
+        }
+        break;
+    }
+    case EnvironmentDeltaMessage: {
+        EnvironmentDelta delta;
+        if (decodeEnvironmentDelta(payload, delta)) {
+            emit environmentDeltaReceived(delta);
+        } else {
+            qWarning() << "R session channel: malformed environment delta";
+        }
+        break;
+    }
+    case ChildrenMessage: {
+        EnvironmentChildren children;
+        if (decodeChildren(payload, children)) {
+            emit childrenReceived(children);
+        } else {
+            qWarning() << "R session channel: malformed children message";
+        }
+        break;
+    }
+    case TableInfoMessage: {
+        DataTableInfo info;
+        if (decodeTableInfo(payload, info)) {
+            emit tableInfoReceived(info);
+        } else {
+            qWarning() << "R session channel: malformed table info";
+        }
+        break;
+    }
+    case TableRowsMessage: {
+        DataTablePage page;
+        if (decodeTablePage(payload, page)) {
+            emit tablePageReceived(page);
+        } else {
+            qWarning() << "R session channel: malformed table rows";
+        }
+        break;
+    }
+    case TableRowsSharedMessage: {
+        DataTablePage page;
+        if (decodeSharedTablePage(payload, page)) {
+            emit tablePageReceived(page);
+        } else {
+            qWarning() << "R session channel: cannot map shared table rows";
+        }
+        break;
+    }
+    case EvalResultMessage: {
+        EvalResult result;
+        if (decodeEvalResult(payload, result)) {
+            emit evalFinished(result);
+        } else {
+            qWarning() << "R session channel: malformed eval result";
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool SessionChannel::decodeEnvironment(const QByteArray &payload, EnvironmentSnapshot &snapshot)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    in >> snapshot.totalSize;
+    return in.status() == QDataStream::Ok && decodeEntries(in, snapshot.entries);
+}
+
+bool SessionChannel::decodeEnvironmentDelta(const QByteArray &payload, EnvironmentDelta &delta)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 removed = 0;
+    in >> delta.totalSize >> removed;
+    if (in.status() != QDataStream::Ok || removed > quint32(in.device()->bytesAvailable() / 4)) {
+        return false;
+    }
+
+    delta.removed.clear();
+    delta.removed.reserve(int(removed));
+    for (quint32 i = 0; i < removed; ++i) {
+        QString name;
+        if (!readString(in, name)) return false;
+        delta.removed.append(name);
+    }
+    return decodeEntries(in, delta.entries);
+}
+
+bool SessionChannel::decodeChildren(const QByteArray &payload, EnvironmentChildren &children)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 count = 0;
+    in >> children.requestId >> children.total >> children.offset >> count;
+    if (in.status() != QDataStream::Ok) return false;
+
+    children.keys.clear();
+    children.entries.clear();
+    children.entries.reserve(int(qMin<quint32>(count, 1 << 20)));
+    for (quint32 i = 0; i < count; ++i) {
+        QString key;
+        EnvironmentEntry entry;
+        if (!readString(in, key) || !decodeEntry(in, entry)) return false;
+        children.keys.append(key);
+        children.entries.append(entry);
+    }
+    return true;
+}
+
+bool SessionChannel::decodeTableInfo(const QByteArray &payload, DataTableInfo &info)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 columns = 0;
+    in >> info.viewId >> info.generation >> info.rows >> info.totalRows >> columns;
+    if (in.status() != QDataStream::Ok || columns > quint32(in.device()->bytesAvailable() / 8)) {
+        return false;
+    }
+
+    info.columnNames.clear();
+    info.columnTypes.clear();
+    for (QStringList *list : {&info.columnNames, &info.columnTypes}) {
+        for (quint32 i = 0; i < columns; ++i) {
+            QString value;
+            if (!readString(in, value)) return false;
+            list->append(value);
+        }
+    }
+    return readString(in, info.error);
+}
+
+bool SessionChannel::decodeTablePage(const QByteArray &payload, DataTablePage &page)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 firstColumn = 0;
+    quint32 rows = 0;
+    quint32 columns = 0;
+    in >> page.viewId >> page.generation >> page.firstRow >> firstColumn >> rows >> columns;
+    if (in.status() != QDataStream::Ok || firstColumn > INT_MAX) return false;
+    // Every cell costs at least its 4-byte length
+    if (rows > 0 && columns > quint32(in.device()->bytesAvailable() / 4) / rows) return false;
+
+    page.firstColumn = int(firstColumn);
+    page.rowCount = int(rows);
+    page.columnCount = int(columns);
+    page.cells.clear();
+    page.cells.reserve(int(rows * columns));
+
+    QVector<quint32> lengths(int(rows));
+    for (quint32 c = 0; c < columns; ++c) {
+        qint64 bytes = 0;
+        for (quint32 &length : lengths) {
+            in >> length;
+            bytes += length;
+        }
+        if (in.status() != QDataStream::Ok || bytes > in.device()->bytesAvailable()) {
+            return false;
+        }
+        QByteArray data(bytes, Qt::Uninitialized);
+        if (in.readRawData(data.data(), int(bytes)) != int(bytes)) return false;
+        const char *p = data.constData();
+        for (quint32 length : lengths) {
+            page.cells.append(QString::fromUtf8(p, qsizetype(length)));
+            p += length;
+        }
+    }
+    return true;
+}
+
+bool SessionChannel::decodeSharedTablePage(const QByteArray &payload, DataTablePage &page)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 firstColumn = 0;
+    quint32 rows = 0;
+    QString name;
+    double size = 0;
+    in >> page.viewId >> page.generation >> page.firstRow >> firstColumn >> rows;
+    if (in.status() != QDataStream::Ok || firstColumn > INT_MAX || !readString(in, name)) return false;
+    in >> size;
+    if (in.status() != QDataStream::Ok) return false;
+
+    // Mapped even if the page turns out to be stale, so the segment is
+    // always unlinked
+    page.shared = SharedColumns::open(name, qint64(size));
+    if (!page.shared || page.shared->rowCount() != int(rows)) return false;
+    page.firstColumn = int(firstColumn);
+    page.rowCount = page.shared->rowCount();
+    page.columnCount = page.shared->columnCount();
+    return true;
+}
+
+bool SessionChannel::decodeEntries(QDataStream &in, QVector<EnvironmentEntry> &entries)
+{
+    quint32 count = 0;
+    in >> count;
+    if (in.status() != QDataStream::Ok) return false;
+
+    entries.clear();
+    entries.reserve(int(qMin<quint32>(count, 1 << 20)));
+    for (quint32 i = 0; i < count; ++i) {
+        EnvironmentEntry entry;
+        if (!decodeEntry(in, entry)) return false;
+        entries.append(entry);
+    }
+    return true;
+}
+
+bool SessionChannel::decodeEntry(QDataStream &in, EnvironmentEntry &entry)
+{
+    quint32 ndim = 0;
+    quint8 flags = 0;
+    if (!readString(in, entry.name) || !readString(in, entry.type)) return false;
+    in >> ndim;
+    if (in.status() != QDataStream::Ok || ndim > quint32(in.device()->bytesAvailable() / 8)) {
+        return false;
+    }
+    entry.dim.resize(int(ndim));
+    for (double &d : entry.dim) {
+        in >> d;
+    }
+    in >> entry.length >> entry.size >> flags;
+    entry.expandable = flags & 1;
+    return in.status() == QDataStream::Ok;
+}
+
+bool SessionChannel::decodeEvalResult(const QByteArray &payload, EvalResult &result)
+{
+    QDataStream in(payload);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    quint8 ok = 0;
+    in >> result.requestId >> ok;
+    if (in.status() != QDataStream::Ok) return false;
+    result.ok = ok != 0;
+    return readString(in, result.output) && readString(in, result.error);
+}
@@ -0,0 +1,207 @@
+#ifndef SESSIONCHANNEL_H
+#define SESSIONCHANNEL_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "sharedcolumns.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QDataStream;
+
+// One object in the R global environment, as reported by qide
+struct EnvironmentEntry {
+    QString name;
+    QString type;
+    QVector<double> dim;
+    double length = 0;
+    double size = 0;
+    // Has children to drill into (list elements, columns, slots, members)
+    bool expandable = false;
+};
+
+struct EnvironmentSnapshot {
+    double totalSize = 0;
+    QVector<EnvironmentEntry> entries;
+};
+
+// Changes since the previous snapshot or delta; entries are new or changed
+struct EnvironmentDelta {
+    double totalSize = 0;
+    QStringList removed;
+    QVector<EnvironmentEntry> entries;
+};
+
+// One page of the children of an object, in reply to a children request.
+// keys[i] is the path element R resolves entries[i] by.
+struct EnvironmentChildren {
+    quint32 requestId = 0;
+    double total = 0;
+    quint32 offset = 0;
+    QStringList keys;
+    QVector<EnvironmentEntry> entries;
+};
+
+// Shape of a data viewer table after a query
+struct DataTableInfo {
+    quint32 viewId = 0;
+    quint32 generation = 0;
+    // Rows left after filtering, and in the whole object
+    double rows = 0;
+    double totalRows = 0;
+    QStringList columnNames;
+    QStringList columnTypes;
+    // Why the last query failed; the previous row order is kept
+    QString error;
+};
+
+// Rows firstRow .. firstRow + rowCount - 1 of columns firstColumn ..
+// firstColumn + columnCount - 1 of a table, either as text
+// cells column by column or as a mapped shared-memory segment
+struct DataTablePage {
+    quint32 viewId = 0;
+    quint32 generation = 0;
+    double firstRow = 0;
+    int firstColumn = 0;
+    int rowCount = 0;
+    int columnCount = 0;
+    QVector<QString> cells;
+    std::shared_ptr<SharedColumns> shared;
+
+    QString cell(int row, int column) const
+    {
+        return shared ? shared->cell(row, column) : cells.at(column * rowCount + row);
+    }
+};
+
+// Outcome of code evaluated out of band with SessionChannel::evaluate()
+struct EvalResult {
+    quint32 requestId = 0;
+    bool ok = false;
+    // Printed output, messages and warnings
+    QString output;
+    QString error;
+};
+
+// Private channel between Q and the qide package inside one R session.
+// Each R terminal gets its own QLocalServer, whose address is handed to R
+// in Q_SESSION_SOCKET; qide connects to it and pushes framed messages.
+//
+// Frame layout, all integers little-endian:
+//   u32 payload length | u8 message type | payload
+// Strings are a u32 byte count followed by UTF-8 bytes, numbers are f64.
+class SessionChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum MessageType : quint8 {
+        // f64 total size, u32 count, then per object: name, type,
+        // u32 ndim, ndim x f64 dim, f64 length, f64 size, u8 flags
+        // (bit 0: expandable)
+        EnvironmentMessage = 1,
+        // f64 total size, u32 count + names of removed objects, then the
+        // new or changed objects as in EnvironmentMessage. A negative size
+        // means qide has not sized the object yet.
+        EnvironmentDeltaMessage = 2,
+        // Q -> R, no payload: size more pending objects while idle
+        SizeRequestMessage = 3,
+        // Q -> R: u32 request id, u32 count + path strings (object name,
+        // then child keys), u32 offset, u32 count
+        ChildrenRequestMessage = 4,
+        // u32 request id, f64 total children, u32 offset, u32 count, then
+        // per child: key, followed by an entry as in EnvironmentMessage
+        ChildrenMessage = 5,
+        // Q -> R: u32 view id, u32 generation, u32 count + path strings,
+        // i32 sort column (-1 for none), u8 descending, filter expression.
+        // Opens the view on first use; R filters and sorts the rows.
+        TableQueryMessage = 6,
+        // u32 view id, u32 generation, f64 rows, f64 total rows, u32
+        // ncol, ncol column names, ncol column types, error message
+        TableInfoMessage = 7,
+        // Q -> R: u32 view id, u32 generation, f64 first row, u32 count,
+        // u32 first column, u32 column count, u8 shared (reply with
+        // TableRowsSharedMessage if possible)
+        TableRowsRequestMessage = 8,
+        // u32 view id, u32 generation, f64 first row, u32 first column,
+        // u32 count, u32 ncol, then per column count x u32 byte lengths
+        // followed by the concatenated UTF-8 bytes of its cells
+        TableRowsMessage = 9,
+        // Q -> R: u32 view id; R drops the view
+        TableCloseMessage = 10,
+        // u32 view id, u32 generation, f64 first row, u32 first column,
+        // u32 count, name and f64 size of a shared-memory segment holding
+        // the rows as typed columns (see SharedColumns)
+        TableRowsSharedMessage = 11,
+        // Q -> R, u32 sequence: answered with IdleMessage only from the
+        // top-level prompt with no console input waiting, ignored otherwise
+        PingMessage = 12,
+        // u32 sequence of the ping answered: R is idle at the prompt
+        IdleMessage = 13,
+        // Q -> R: u32 request id, code. R evaluates it in the global
+        // environment away from the console, held until R is at the
+        // top-level prompt.
+        EvalMessage = 14,
+        // u32 request id, u8 ok, output, error message
+        EvalResultMessage = 15
+    };
+
+    explicit SessionChannel(QObject *parent = nullptr);
+    ~SessionChannel();
+
+    // Address to export to R; empty if the server could not listen
+    QString address() const;
+    bool isConnected() const { return client != nullptr; }
+    bool send(quint8 type, const QByteArray &payload = QByteArray());
+    bool requestChildren(quint32 requestId, const QStringList &path, quint32 offset, quint32 count);
+    bool queryTable(quint32 viewId, quint32 generation, const QStringList &path,
+                    int sortColumn, bool descending, const QString &filter);
+    bool requestTableRows(quint32 viewId, quint32 generation, double firstRow, quint32 count,
+                          quint32 firstColumn, quint32 columnCount);
+    bool closeTable(quint32 viewId);
+    // Runs code in R without typing it into the console, once R is idle.
+    // Returns the request id evalFinished() reports, 0 if not connected.
+    quint32 evaluate(const QString &code);
+
+    static bool decodeEnvironment(const QByteArray &payload, EnvironmentSnapshot &snapshot);
+    static bool decodeEnvironmentDelta(const QByteArray &payload, EnvironmentDelta &delta);
+    static bool decodeChildren(const QByteArray &payload, EnvironmentChildren &children);
+    static bool decodeTableInfo(const QByteArray &payload, DataTableInfo &info);
+    static bool decodeTablePage(const QByteArray &payload, DataTablePage &page);
+    static bool decodeSharedTablePage(const QByteArray &payload, DataTablePage &page);
+    static bool decodeEvalResult(const QByteArray &payload, EvalResult &result);
+
+signals:
+    void connected();
+    void disconnected();
+    void messageReceived(quint8 type, const QByteArray &payload);
+    void environmentReceived(const EnvironmentSnapshot &snapshot);
+    void environmentDeltaReceived(const EnvironmentDelta &delta);
+    void childrenReceived(const EnvironmentChildren &children);
+    void tableInfoReceived(const DataTableInfo &info);
+    void tablePageReceived(const DataTablePage &page);
+    void evalFinished(const EvalResult &result);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    // Refuse frames above this size rather than buffer without bound
+    static constexpr quint32 MaxFrameSize = 256 * 1024 * 1024;
+
+    void dispatch(quint8 type, const QByteArray &payload);
+    static bool decodeEntries(QDataStream &in, QVector<EnvironmentEntry> &entries);
+    static bool decodeEntry(QDataStream &in, EnvironmentEntry &entry);
+
+    QLocalServer *server;
+    QLocalSocket *client = nullptr;
+    QByteArray buffer;
+    quint32 lastEvalId = 0;
+};
+
+#endif // SESSIONCHANNEL_H
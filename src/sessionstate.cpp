@@ -0,0 +1,80 @@
+#include "sessionstate.h"
+#include "sessionchannel.h"
+#include <QTimer>
+#include <QtEndian>
+
+SessionState::SessionState(SessionChannel *channel, QObject *parent)
+    : QObject(parent), channel(channel)
+{
+    pingTimer = new QTimer(this);
+    pingTimer->setSingleShot(true);
+    connect(pingTimer, &QTimer::timeout, this, [this]() {
+        sendPing();
+        // Keep asking until R answers; busy pings go unanswered
+        if (busy) pingTimer->start(PingInterval);
+    });
+
+    if (channel) {
+        connect(channel, &SessionChannel::messageReceived, this, [this](quint8 type, const QByteArray &payload) {
+            if (type == SessionChannel::IdleMessage) onIdleMessage(payload);
+        });
+        connect(channel, &SessionChannel::disconnected, this, [this]() {
+            pingTimer->stop();
+            setBusy(false);
+        });
+    }
+}
+
+bool SessionState::isConnected() const
+{
+    return channel && channel->isConnected();
+}
+
+void SessionState::inputSent()
+{
+    if (!isConnected()) return;
+    setBusy(true);
+    firstSequence = pingSequence + 1;
+    confirmSequence = 0;
+    // Restarting on every input means the ping follows the last of a
+    // burst of lines
+    pingTimer->start(PingDelay);
+}
+
+void SessionState::sendPing()
+{
+    if (!channel) return;
+    char payload[4];
+    qToLittleEndian<quint32>(++pingSequence, payload);
+    channel->send(SessionChannel::PingMessage, QByteArray(payload, 4));
+}
+
+void SessionState::onIdleMessage(const QByteArray &payload)
+{
+    if (payload.size() != 4 || !busy) return;
+    const quint32 sequence = qFromLittleEndian<quint32>(payload.constData());
+    if (sequence < firstSequence) return;
+
+    // The terminal may still be writing the rest of a long paste when R
+    // runs out of input, so one answer is not enough
+    if (confirmSequence == 0) {
+        confirmSequence = pingSequence + 1;
+        pingTimer->start(PingDelay);
+    } else if (sequence >= confirmSequence) {
+        pingTimer->stop();
+        setBusy(false);
+    }
+}
+
+void SessionState::setBusy(bool value)
+{
+    if (busy == value) return;
+    busy = value;
+    if (busy) {
+        busyTimer.start();
+    }
+    emit busyChanged(busy);
+    if (!busy) {
+        emit idle();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SESSIONSTATE_H
+#define SESSIONSTATE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+
+class QTimer;
+class SessionChannel;
+
+// Whether the R session behind a console is evaluating or waiting at the
+// prompt. Input sent to R (a command from the IDE or Enter typed in the
+// console) marks it busy; Q then pings qide until it answers. qide only
+// answers from the top-level prompt with no console input left to read,
+// and a second ping confirms the answer, so R counts as idle once the
+// command has finished, errors and interrupts included.
+class SessionState : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionState(SessionChannel *channel, QObject *parent = nullptr);
+
+    // Without a qide connection nothing can be tracked; R counts as idle
+    bool isConnected() const;
+    bool isBusy() const { return busy; }
+    // Milliseconds since R became busy, 0 when idle
+    qint64 busyElapsed() const { return busy ? busyTimer.elapsed() : 0; }
+
+public slots:
+    void inputSent();
+
+signals:
+    void busyChanged(bool busy);
+    void idle();
+
+private:
+    // Time R gets to read the input before the first ping, and between
+    // an answer and the ping confirming it
+    static constexpr int PingDelay = 100;
+    // Pings R ignores while busy are repeated this often (ms)
+    static constexpr int PingInterval = 250;
+
+    void setBusy(bool value);
+    void sendPing();
+    void onIdleMessage(const QByteArray &payload);
+
+    QPointer<SessionChannel> channel;
+    QTimer *pingTimer;
+    QElapsedTimer busyTimer;
+    bool busy = false;
+    quint32 pingSequence = 0;
+    // First ping sent after the last input; answers to older ones do
+    // not count
+    quint32 firstSequence = 0;
+    // First confirming ping, 0 while R has not answered yet
+    quint32 confirmSequence = 0;
+};
+
+#endif // SESSIONSTATE_H
@@ -0,0 +1,190 @@
+#include "sharedcolumns.h"
+#include <QtGlobal>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 Magic = 0x4c4f4351;  // "QCOL"
+const quint32 Version = 1;
+const qint64 HeaderSize = 16;
+const qint64 DescriptorSize = 32;
+
+// R's NA_integer_ and NA_logical_
+const qint32 NaInteger = INT_MIN;
+
+// A finite double as R prints it by default (digits = 7, scipen = 0):
+// the fewest significant digits, up to 7, that show the value, in fixed
+// notation unless scientific notation is narrower
+QString formatDouble(double v)
+{
+    if (v == 0) return QStringLiteral("0");
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6e", v);
+    const char *e = std::strchr(buffer, 'e');
+    const int exponent = std::atoi(e + 1);
+    int digits = 7;
+    for (const char *p = e - 1; digits > 1 && *p == '0'; --p) --digits;
+
+    const int sign = v < 0 ? 1 : 0;
+    const int scientificWidth = sign + (digits > 1 ? digits + 1 : 1) + (std::abs(exponent) >= 100 ? 5 : 4);
+    const int decimals = qMax(0, digits - exponent - 1);
+    const int fixedWidth = sign + qMax(1, exponent + 1) + (decimals > 0 ? decimals + 1 : 0);
+    if (fixedWidth <= scientificWidth) {
+        return QString::number(v, 'f', decimals);
+    }
+    return QString::number(v, 'e', digits - 1);
+}
+
+} // namespace
+
+SharedColumns::~SharedColumns()
+{
+#ifdef Q_OS_UNIX
+    if (base) {
+        munmap(base, size_t(size));
+    }
+#endif
+}
+
+bool SharedColumns::isSupported()
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::shared_ptr<SharedColumns> SharedColumns::open(const QString &name, qint64 size)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray path = name.toLocal8Bit();
+    const int fd = shm_open(path.constData(), O_RDONLY, 0);
+    // The name is only needed to find the segment; unlinking it now means
+    // nothing is left behind whatever happens next
+    shm_unlink(path.constData());
+    if (fd < 0) return nullptr;
+
+    // Trust the segment's own size over the message
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < size || size < HeaderSize) {
+        close(fd);
+        return nullptr;
+    }
+    void *mapping = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<SharedColumns> columns(new SharedColumns);
+    columns->base = static_cast<uchar*>(mapping);
+    columns->size = size;
+    if (!columns->parse()) return nullptr;
+    return columns;
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(size);
+    return nullptr;
+#endif
+}
+
+bool SharedColumns::parse()
+{
+    quint32 header[4];
+    std::memcpy(header, base, sizeof(header));
+    if (header[0] != Magic || header[1] != Version || header[2] > quint32(INT_MAX)) return false;
+
+    rows = int(header[2]);
+    const qint64 ncol = header[3];
+    if (HeaderSize + ncol * DescriptorSize > size) return false;
+
+    // Every section must lie inside the mapping, so cell() can read
+    // without further checks (string offsets are checked per cell)
+    auto fits = [this](quint64 offset, qint64 bytes) {
+        return offset <= quint64(size) && bytes <= size - qint64(offset) && offset % 8 == 0;
+    };
+    const qint64 validityBytes = (qint64(rows) + 7) / 8;
+
+    columns.resize(int(ncol));
+    for (int j = 0; j < ncol; ++j) {
+        const uchar *d = base + HeaderSize + j * DescriptorSize;
+        quint32 type;
+        quint64 data, validity, offsets;
+        std::memcpy(&type, d, 4);
+        std::memcpy(&data, d + 8, 8);
+        std::memcpy(&validity, d + 16, 8);
+        std::memcpy(&offsets, d + 24, 8);
+
+        Column &column = columns[j];
+        column.type = type;
+        if (!fits(validity, validityBytes)) return false;
+        column.validity = base + validity;
+
+        switch (type) {
+        case Double:
+            if (!fits(data, qint64(rows) * 8)) return false;
+            break;
+        case Integer:
+        case Logical:
+            if (!fits(data, qint64(rows) * 4)) return false;
+            break;
+        case String:
+            if (!fits(offsets, (qint64(rows) + 1) * 8) || !fits(data, 0)) return false;
+            column.offsets = reinterpret_cast<const quint64*>(base + offsets);
+            break;
+        default:
+            return false;
+        }
+        column.data = base + data;
+    }
+    return true;
+}
+
+QString SharedColumns::cell(int row, int column) const
+{
+    if (row < 0 || row >= rows || column < 0 || column >= columns.size()) return QString();
+
+    const Column &c = columns.at(column);
+    if (!(c.validity[row >> 3] & (1u << (row & 7)))) {
+        return QStringLiteral("NA");
+    }
+
+    switch (c.type) {
+    case Double: {
+        double v;
+        std::memcpy(&v, c.data + qint64(row) * 8, 8);
+        if (std::isnan(v)) return QStringLiteral("NaN");
+        if (std::isinf(v)) return v > 0 ? QStringLiteral("Inf") : QStringLiteral("-Inf");
+        return formatDouble(v);
+    }
+    case Integer: {
+        qint32 v;
+        std::memcpy(&v, c.data + qint64(row) * 4, 4);
+        return QString::number(v);
+    }
+    case Logical: {
+        qint32 v;
+        std::memcpy(&v, c.data + qint64(row) * 4, 4);
+        if (v == NaInteger) return QStringLiteral("NA");
+        return v ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+    }
+    case String: {
+        const quint64 begin = c.offsets[row];
+        const quint64 end = c.offsets[row + 1];
+        const quint64 available = quint64(size) - quint64(c.data - base);
+        if (begin > end || end > available) return QString();
+        return QString::fromUtf8(reinterpret_cast<const char*>(c.data + begin), qsizetype(end - begin));
+    }
+    }
+    return QString();
+}
@@ -0,0 +1,45 @@
+#ifndef SHAREDCOLUMNS_H
+#define SHAREDCOLUMNS_H
+
+#include <QString>
+#include <QVector>
+#include <memory>
+
+// Read-only view of a page of data viewer columns that qide wrote into a
+// POSIX shared-memory segment (layout in qiderpkg/src/columns.c). Values
+// are read straight from the mapping and only formatted when a cell is
+// painted. The segment is unlinked as soon as it is mapped, so its memory
+// goes away with the last SharedColumns referring to it.
+class SharedColumns
+{
+public:
+    ~SharedColumns();
+
+    // Maps and validates the segment; nullptr on failure
+    static std::shared_ptr<SharedColumns> open(const QString &name, qint64 size);
+    static bool isSupported();
+
+    int rowCount() const { return rows; }
+    int columnCount() const { return columns.size(); }
+    QString cell(int row, int column) const;
+
+private:
+    enum Type : quint32 { Double = 1, Integer = 2, Logical = 3, String = 4 };
+
+    struct Column {
+        quint32 type = 0;
+        const uchar *validity = nullptr;
+        const uchar *data = nullptr;
+        const quint64 *offsets = nullptr;
+    };
+
+    SharedColumns() = default;
+    bool parse();
+
+    uchar *base = nullptr;
+    qint64 size = 0;
+    int rows = 0;
+    QVector<Column> columns;
+};
+
+#endif // SHAREDCOLUMNS_H
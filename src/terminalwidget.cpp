@@ -1,13 +1,20 @@
 #include "terminalwidget.h"
+#include "sessionchannel.h"
+#include "executionqueue.h"
+#include "sessionstate.h"
 #include <QDir>
 #include <QFileInfo>
 #include <QApplication>
 #include <QClipboard>
 #include <QContextMenuEvent>
+#include <QKeyEvent>
 #include <QProcessEnvironment>
+#include <QSettings>
 #include <QStandardPaths>
 #include <QTextStream>
 #include <QRegularExpression>
+#include <QDebug>
+#include <signal.h>
 
 TerminalWidget::TerminalWidget(const QString &shell, QWidget *parent)
     : QTermWidget(0, parent)
@@ -70,7 +77,8 @@ TerminalWidget::TerminalWidget(const QString &shell, QWidget *parent)
     
     // Convert system environment to string list, skipping locale vars we'll override
     for (const QString &key : sysEnv.keys()) {
-        if (key != "LANG" && key != "LC_ALL" && key != "TERM" && key != "R_PROFILE_USER") {
+        if (key != "LANG" && key != "LC_ALL" && key != "TERM" && key != "R_PROFILE_USER"
+                && key != "Q_SESSION_SOCKET" && key != "Q_PRELOAD_PACKAGES") {
             env << QString("%1=%2").arg(key, sysEnv.value(key));
         }
     }
@@ -83,6 +91,42 @@ TerminalWidget::TerminalWidget(const QString &shell, QWidget *parent)
     // Setup R profile for silent loading
     QString shellName = QFileInfo(shellPath).fileName().toLower();
     if (shellName == "r") {
+        // qide connects back to this channel; the address is per session so
+        // several R consoles and several Q instances never share one
+        channel = new SessionChannel(this);
+        state = new SessionState(channel, this);
+        queue = new ExecutionQueue(this, state, this);
+        interruptTimer = new QTimer(this);
+        interruptTimer->setInterval(InterruptRetryInterval);
+        connect(interruptTimer, &QTimer::timeout, this, [this]() {
+            if (!state->isBusy()) {
+                interruptTimer->stop();
+            } else if (interruptAttempts < MaxInterruptAttempts) {
+                ++interruptAttempts;
+                sendSignal(SIGINT);
+            } else {
+                interruptTimer->stop();
+                emit interruptIgnored();
+            }
+        });
+        connect(state, &SessionState::idle, interruptTimer, &QTimer::stop);
+        // Commands typed into the console make R busy just the same
+        connect(this, &QTermWidget::termKeyPressed, this, [this](QKeyEvent *event) {
+            if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
+                state->inputSent();
+            }
+        });
+        if (!channel->address().isEmpty()) {
+            env << "Q_SESSION_SOCKET=" + channel->address();
+        }
+
+        // Attached at startup, so pooled sessions come with them ready
+        QSettings settings("Q", "Q");
+        const QStringList packages = settings.value("r/preloadPackages").toStringList();
+        if (!packages.isEmpty()) {
+            env << "Q_PRELOAD_PACKAGES=" + packages.join(',');
+        }
+        
         QString initScriptPath = QDir::tempPath() + "/q_init_" + QString::number(QCoreApplication::applicationPid()) + ".R";
         QFile initScript(initScriptPath);
         if (initScript.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -97,7 +141,11 @@ TerminalWidget::TerminalWidget(const QString &shell, QWidget *parent)
             out << "  }\n";
             out << "  if (requireNamespace('qide', quietly=TRUE)) {\n";
             out << "    library(qide)\n";
-            out << "    qide::init_monitor('/tmp/q_env.json')\n";
+            out << "    qide::init_monitor()\n";
+            out << "  }\n";
+            out << "  for (pkg in strsplit(Sys.getenv('Q_PRELOAD_PACKAGES'), ',', fixed = TRUE)[[1]]) {\n";
+            out << "    if (!suppressPackageStartupMessages(require(pkg, character.only = TRUE, quietly = TRUE)))\n";
+            out << "      message('Cannot attach preloaded package ', pkg)\n";
             out << "  }\n";
             out << "})\n";
             initScript.close();
@@ -192,6 +240,59 @@ void TerminalWidget::writeToShell(const QString &text)
 void TerminalWidget::executeCommand(const QString &command)
 {
     sendText(command + "\n");
+    if (state) {
+        state->inputSent();
+    }
+}
+
+void TerminalWidget::runCode(const QString &code)
+{
+    if (queue) {
+        queue->enqueue(code);
+    } else {
+        executeCommand(code);
+    }
+}
+
+void TerminalWidget::interrupt()
+{
+    // Whatever was waiting for the interrupted code must not run either
+    if (queue) {
+        queue->clear();
+    }
+    sendSignal(SIGINT);
+
+    // Without qide there is no telling whether R stopped, so no retries
+    if (state && state->isBusy()) {
+        interruptAttempts = 1;
+        interruptTimer->start();
+    }
+}
+
+void TerminalWidget::terminateShell()
+{
+    if (interruptTimer) {
+        interruptTimer->stop();
+    }
+    sendSignal(SIGKILL);
+}
+
+void TerminalWidget::sendSignal(int signal)
+{
+    const int pid = getShellPID();
+    if (pid <= 0) return;
+    if (::kill(pid, signal) != 0) {
+        qWarning() << "Cannot signal process" << pid;
+    }
+}
+
+quint32 TerminalWidget::evaluate(const QString &code)
+{
+    if (channel && channel->isConnected()) {
+        return channel->evaluate(code);
+    }
+    runCode(code);
+    return 0;
 }
 
 
@@ -7,6 +7,10 @@
 #include <QShortcut>
 #include <QTimer>
 
+class SessionChannel;
+class ExecutionQueue;
+class SessionState;
+
 class TerminalWidget : public QTermWidget
 {
     Q_OBJECT
@@ -20,6 +24,28 @@ public:
     void setArgs(const QStringList &args);
     void writeToShell(const QString &text);
     void executeCommand(const QString &command);
+    // Runs code from the editor or the IDE: through the execution queue
+    // in R consoles, so it waits until R is idle; typed like
+    // executeCommand() elsewhere
+    void runCode(const QString &code);
+    // Runs code on behalf of the IDE (refresh, rm, setwd, ...) over the
+    // session channel, so it stays out of the console and its history.
+    // Without qide it falls back to runCode() and returns 0.
+    quint32 evaluate(const QString &code);
+    // Socket qide in this R session reports through; null for other shells
+    SessionChannel *sessionChannel() const { return channel; }
+    ExecutionQueue *executionQueue() const { return queue; }
+    SessionState *sessionState() const { return state; }
+
+    // Drops queued code and sends SIGINT to the shell process, repeating
+    // it while R stays busy; interruptIgnored() is emitted once the
+    // retries are used up
+    void interrupt();
+    // Kills the shell process outright, for when interrupting fails
+    void terminateShell();
+
+signals:
+    void interruptIgnored();
 
 protected:
     void contextMenuEvent(QContextMenuEvent *event) override;
@@ -29,6 +55,17 @@ private:
     EditorTheme currentTheme;
     QShortcut *copyShortcut;
     QShortcut *pasteShortcut;
+    SessionChannel *channel = nullptr;
+    ExecutionQueue *queue = nullptr;
+    SessionState *state = nullptr;
+
+    // R only acts on SIGINT at its next interrupt check, which compiled
+    // code may not reach for a while
+    static constexpr int InterruptRetryInterval = 2000;
+    static constexpr int MaxInterruptAttempts = 3;
+    void sendSignal(int signal);
+    QTimer *interruptTimer = nullptr;
+    int interruptAttempts = 0;
 };
 
 #endif // TERMINALWIDGET_H
@@ -1,4 +1,5 @@
 #include "thememanager.h"
+#include "bundledthemes.h"
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -9,6 +10,144 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QSettings>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QDateTime>
+
+namespace {
+
+// Bump when EditorTheme or the index layout changes
+const quint32 ThemeIndexMagic = 0x51544849; // "QTHI"
+const quint32 ThemeIndexVersion = 1;
+
+void writeTheme(QDataStream &out, const EditorTheme &theme)
+{
+    out << theme.name << theme.author << theme.variant
+        << theme.background << theme.foreground << theme.cursor
+        << theme.selection << theme.lineHighlight << theme.lineNumber << theme.lineNumberBg
+        << theme.color_01 << theme.color_02 << theme.color_03 << theme.color_04
+        << theme.color_05 << theme.color_06 << theme.color_07 << theme.color_08
+        << theme.color_09 << theme.color_10 << theme.color_11 << theme.color_12
+        << theme.color_13 << theme.color_14 << theme.color_15 << theme.color_16
+        << theme.keyword << theme.function << theme.string
+        << theme.number << theme.comment << theme.operator_;
+}
+
+void readTheme(QDataStream &in, EditorTheme &theme)
+{
+    in >> theme.name >> theme.author >> theme.variant
+       >> theme.background >> theme.foreground >> theme.cursor
+       >> theme.selection >> theme.lineHighlight >> theme.lineNumber >> theme.lineNumberBg
+       >> theme.color_01 >> theme.color_02 >> theme.color_03 >> theme.color_04
+       >> theme.color_05 >> theme.color_06 >> theme.color_07 >> theme.color_08
+       >> theme.color_09 >> theme.color_10 >> theme.color_11 >> theme.color_12
+       >> theme.color_13 >> theme.color_14 >> theme.color_15 >> theme.color_16
+       >> theme.keyword >> theme.function >> theme.string
+       >> theme.number >> theme.comment >> theme.operator_;
+}
+
+qint64 modifiedTime(const QString &path)
+{
+    return QFileInfo(path).lastModified().toMSecsSinceEpoch();
+}
+
+// Fills in the editor colors Gogh themes don't define from the terminal
+// palette; shared by bundled and user JSON themes
+void deriveEditorColors(EditorTheme &theme)
+{
+    // Set selection color (slightly lighter/darker than background)
+    QColor bg = theme.background;
+    int selectionLightness = bg.lightness() + (bg.lightness() < 128 ? 20 : -20);
+    selectionLightness = qBound(0, selectionLightness, 255);
+
+    // For grayscale colors (hue = -1), use RGB manipulation instead of HSL
+    if (bg.hue() == -1) {
+        int r = qBound(0, bg.red() + (bg.lightness() < 128 ? 20 : -20), 255);
+        int g = qBound(0, bg.green() + (bg.lightness() < 128 ? 20 : -20), 255);
+        int b = qBound(0, bg.blue() + (bg.lightness() < 128 ? 20 : -20), 255);
+        theme.selection = QColor(r, g, b);
+    } else {
+        theme.selection = QColor::fromHsl(bg.hue(), bg.saturation(), selectionLightness);
+    }
+
+    // Validate selection color
+    if (!theme.selection.isValid()) {
+        qWarning() << "Invalid selection color calculated, using fallback";
+        theme.selection = QColor(bg.red() + 20, bg.green() + 20, bg.blue() + 20);
+    }
+
+    // Set line highlight (slightly different from background)
+    int lineHighlightLightness = bg.lightness() + (bg.lightness() < 128 ? 10 : -10);
+    lineHighlightLightness = qBound(0, lineHighlightLightness, 255);
+
+    if (bg.hue() == -1) {
+        int r = qBound(0, bg.red() + (bg.lightness() < 128 ? 10 : -10), 255);
+        int g = qBound(0, bg.green() + (bg.lightness() < 128 ? 10 : -10), 255);
+        int b = qBound(0, bg.blue() + (bg.lightness() < 128 ? 10 : -10), 255);
+        theme.lineHighlight = QColor(r, g, b);
+    } else {
+        theme.lineHighlight = QColor::fromHsl(bg.hue(), bg.saturation(), lineHighlightLightness);
+    }
+
+    // Validate line highlight color
+    if (!theme.lineHighlight.isValid()) {
+        qWarning() << "Invalid line highlight color calculated, using fallback";
+        theme.lineHighlight = QColor(bg.red() + 10, bg.green() + 10, bg.blue() + 10);
+    }
+
+    // Set line number colors
+    theme.lineNumber = theme.color_09; // Bright black
+    theme.lineNumberBg = theme.background;
+
+    // Map ANSI colors to syntax highlighting
+    theme.keyword = theme.color_06;   // Magenta - keywords
+    theme.function = theme.color_03;  // Green - functions
+    theme.string = theme.color_04;    // Yellow - strings
+    theme.number = theme.color_05;    // Blue - numbers
+    theme.comment = theme.color_09;   // Bright black - comments
+    theme.operator_ = theme.color_02; // Red - operators
+}
+
+EditorTheme themeFromBundled(const BundledTheme &bundled)
+{
+    auto color = [&](int index, const QColor &fallback) {
+        const int rgb = bundled.colors[index];
+        return rgb < 0 ? fallback : QColor(QRgb(rgb));
+    };
+
+    EditorTheme theme;
+    theme.name = QString::fromUtf8(bundled.name);
+    theme.author = QString::fromUtf8(bundled.author);
+    theme.variant = QString::fromUtf8(bundled.variant);
+
+    // Same defaults as parseJsonTheme for colors a theme leaves out
+    theme.background = color(BundledTheme::Background, QColor("#000000"));
+    theme.foreground = color(BundledTheme::Foreground, QColor("#FFFFFF"));
+    theme.cursor = color(BundledTheme::Cursor, theme.foreground);
+
+    theme.color_01 = color(BundledTheme::Ansi01, QColor("#000000"));
+    theme.color_02 = color(BundledTheme::Ansi02, QColor("#FF0000"));
+    theme.color_03 = color(BundledTheme::Ansi03, QColor("#00FF00"));
+    theme.color_04 = color(BundledTheme::Ansi04, QColor("#FFFF00"));
+    theme.color_05 = color(BundledTheme::Ansi05, QColor("#0000FF"));
+    theme.color_06 = color(BundledTheme::Ansi06, QColor("#FF00FF"));
+    theme.color_07 = color(BundledTheme::Ansi07, QColor("#00FFFF"));
+    theme.color_08 = color(BundledTheme::Ansi08, QColor("#FFFFFF"));
+    theme.color_09 = color(BundledTheme::Ansi09, QColor("#808080"));
+    theme.color_10 = color(BundledTheme::Ansi10, QColor("#FF8080"));
+    theme.color_11 = color(BundledTheme::Ansi11, QColor("#80FF80"));
+    theme.color_12 = color(BundledTheme::Ansi12, QColor("#FFFF80"));
+    theme.color_13 = color(BundledTheme::Ansi13, QColor("#8080FF"));
+    theme.color_14 = color(BundledTheme::Ansi14, QColor("#FF80FF"));
+    theme.color_15 = color(BundledTheme::Ansi15, QColor("#80FFFF"));
+    theme.color_16 = color(BundledTheme::Ansi16, QColor("#FFFFFF"));
+
+    deriveEditorColors(theme);
+    return theme;
+}
+
+} // namespace
 
 ThemeManager& ThemeManager::instance()
 {
@@ -19,21 +158,27 @@ ThemeManager& ThemeManager::instance()
 ThemeManager::ThemeManager()
     : currentThemeName("Dracula")
 {
-    themesDir = findThemesDirectory();
+    // Bundled themes are compiled in; only their names are indexed here and
+    // a theme's colors are built the first time it is requested
+    bundledIndex.reserve(bundledThemeCount);
+    for (int i = 0; i < bundledThemeCount; ++i) {
+        bundledIndex.insert(QString::fromUtf8(bundledThemes[i].name), i);
+    }
     
-    // Scan for available JSON themes
+    // User themes from the config directory are layered on top
+    themesDir = findThemesDirectory();
     scanJsonThemes();
     
     // Load saved theme from settings
     QSettings settings("Q", "Q");
     QString savedTheme = settings.value("theme").toString();
     
-    if (!savedTheme.isEmpty() && jsonThemeNames.contains(savedTheme)) {
+    if (!savedTheme.isEmpty() && hasTheme(savedTheme)) {
         currentThemeName = savedTheme;
-    } else if (jsonThemeNames.contains("Dracula")) {
+    } else if (hasTheme("Dracula")) {
         currentThemeName = "Dracula";
-    } else if (!jsonThemeNames.isEmpty()) {
-        currentThemeName = jsonThemeNames.first();
+    } else if (!bundledIndex.isEmpty() || !jsonThemeNames.isEmpty()) {
+        currentThemeName = availableThemes().first();
     }
     // Apply the selected theme to the application at startup
     EditorTheme initial = getTheme(currentThemeName);
@@ -44,32 +189,97 @@ ThemeManager::ThemeManager()
 
 QString ThemeManager::findThemesDirectory() const
 {
-    const QString path = QCoreApplication::applicationDirPath() + "/gogh-themes";
+    // Optional: users drop extra Gogh JSON files here
+    const QString path = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/themes";
     QDir dir(path);
-    if (dir.exists() && !dir.entryList(QStringList() << "*.json", QDir::Files).isEmpty()) {
+    if (dir.exists()) {
         return dir.absolutePath();
     }
-
-    qWarning() << "Themes directory not found at" << path;
     return QString();
 }
 
+bool ThemeManager::hasTheme(const QString &name) const
+{
+    return themeIndex.contains(name) || bundledIndex.contains(name);
+}
+
 void ThemeManager::scanJsonThemes()
 {
     if (themesDir.isEmpty()) {
-        qWarning() << "Themes directory not set, cannot scan for JSON themes";
         return;
     }
     
+    // Startup reads one small index file instead of opening and parsing
+    // every JSON theme; the index is rebuilt when the directory changes
+    if (!loadThemeIndex()) {
+        buildThemeIndex();
+        saveThemeIndex();
+    }
+    
+    jsonThemeNames = themeIndex.keys();
+    jsonThemeNames.sort(Qt::CaseInsensitive);
+}
+
+QString ThemeManager::themeIndexPath() const
+{
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(cacheDir).filePath("theme-index.bin");
+}
+
+bool ThemeManager::loadThemeIndex()
+{
+    QFile file(themeIndexPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != ThemeIndexMagic || version != ThemeIndexVersion) {
+        return false;
+    }
+    in.setVersion(QDataStream::Qt_6_0);
+    
+    QString indexedDir;
+    qint64 indexedDirModified = 0;
+    quint32 count = 0;
+    in >> indexedDir >> indexedDirModified >> count;
+    
+    // Adding, removing or renaming a theme file touches the directory mtime
+    if (indexedDir != themesDir || indexedDirModified != modifiedTime(themesDir)) {
+        return false;
+    }
+    
+    QHash<QString, ThemeIndexEntry> index;
+    index.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ThemeIndexEntry entry;
+        in >> entry.filePath >> entry.modified;
+        readTheme(in, entry.theme);
+        index.insert(entry.theme.name, entry);
+    }
+    
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Theme index is corrupt, rebuilding";
+        return false;
+    }
+    
+    themeIndex = index;
+    return true;
+}
+
+void ThemeManager::buildThemeIndex()
+{
     QDir dir(themesDir);
     QStringList filters;
     filters << "*.json";
     
     QFileInfoList files = dir.entryInfoList(filters, QDir::Files | QDir::Readable);
     
-    jsonThemeNames.clear();
+    themeIndex.clear();
     for (const QFileInfo &fileInfo : files) {
-        // Read the JSON file to get the theme name
         QFile file(fileInfo.absoluteFilePath());
         if (file.open(QIODevice::ReadOnly)) {
             QByteArray data = file.readAll();
@@ -77,21 +287,49 @@ void ThemeManager::scanJsonThemes()
             
             QJsonDocument doc = QJsonDocument::fromJson(data);
             if (doc.isObject()) {
-                QJsonObject obj = doc.object();
-                QString themeName = obj["name"].toString();
-                if (!themeName.isEmpty()) {
-                    jsonThemeNames.append(themeName);
+                EditorTheme theme = parseJsonTheme(doc.object());
+                if (!theme.name.isEmpty()) {
+                    ThemeIndexEntry entry;
+                    entry.filePath = fileInfo.absoluteFilePath();
+                    entry.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+                    entry.theme = theme;
+                    themeIndex.insert(theme.name, entry);
                 }
             }
         }
     }
+}
+
+void ThemeManager::saveThemeIndex() const
+{
+    const QString path = themeIndexPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
     
-    jsonThemeNames.sort(Qt::CaseInsensitive);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write theme index:" << path;
+        return;
+    }
+    
+    QDataStream out(&file);
+    out << ThemeIndexMagic << ThemeIndexVersion;
+    out.setVersion(QDataStream::Qt_6_0);
+    out << themesDir << modifiedTime(themesDir) << quint32(themeIndex.size());
+    for (const ThemeIndexEntry &entry : themeIndex) {
+        out << entry.filePath << entry.modified;
+        writeTheme(out, entry.theme);
+    }
+    file.commit();
 }
 
 QStringList ThemeManager::availableThemes() const
 {
-    QStringList allThemes = jsonThemeNames;
+    QStringList allThemes = bundledIndex.keys();
+    for (const QString &name : jsonThemeNames) {
+        if (!bundledIndex.contains(name)) {
+            allThemes.append(name);
+        }
+    }
     allThemes.sort(Qt::CaseInsensitive);
     return allThemes;
 }
@@ -103,10 +341,14 @@ EditorTheme ThemeManager::getTheme(const QString &name) const
         return themes.value(name);
     }
     
-    // Check if it's a JSON theme that needs to be loaded
-    if (jsonThemeNames.contains(name)) {
-        // Load it on-demand
-        EditorTheme theme = loadThemeFromJson(name);
+    // Indexed themes are already parsed; only a file edited in place since
+    // the index was written needs to be read again
+    auto entry = themeIndex.constFind(name);
+    if (entry != themeIndex.constEnd()) {
+        EditorTheme theme = entry->theme;
+        if (modifiedTime(entry->filePath) != entry->modified) {
+            theme = loadThemeFromJson(name);
+        }
         if (!theme.name.isEmpty()) {
             // Cache it for future use
             const_cast<ThemeManager*>(this)->themes[name] = theme;
@@ -114,6 +356,13 @@ EditorTheme ThemeManager::getTheme(const QString &name) const
         }
     }
     
+    auto bundled = bundledIndex.constFind(name);
+    if (bundled != bundledIndex.constEnd()) {
+        EditorTheme theme = themeFromBundled(bundledThemes[*bundled]);
+        const_cast<ThemeManager*>(this)->themes[name] = theme;
+        return theme;
+    }
+    
     // Return a fallback theme
     qWarning() << "Theme not found:" << name << ", returning fallback theme";
     EditorTheme fallback;
@@ -153,6 +402,20 @@ void ThemeManager::setCurrentTheme(const QString &name)
 
 QString ThemeManager::toStyleSheet(const EditorTheme &theme) const
 {
+    // The sheet only depends on these five colors, so it is built once per
+    // theme and reused on every later switch back to it
+    const QString background = theme.background.name();
+    const QString foreground = theme.foreground.name();
+    const QString selection = theme.selection.name();
+    const QString lineNumber = theme.lineNumber.name();
+    const QString lineHighlight = theme.lineHighlight.name();
+    const QString key = background + foreground + selection + lineNumber + lineHighlight;
+    
+    auto cached = styleSheetCache.constFind(key);
+    if (cached != styleSheetCache.constEnd()) {
+        return *cached;
+    }
+    
     // Create a comprehensive stylesheet for the entire application
     QString stylesheet;
     
@@ -280,22 +543,34 @@ QString ThemeManager::toStyleSheet(const EditorTheme &theme) const
         "   padding: 4px;"
         "   border: 1px solid %4;"
         "}"
-    ).arg(theme.background.name())
-     .arg(theme.foreground.name())
-     .arg(theme.selection.name())
-     .arg(theme.lineNumber.name())
-     .arg(theme.lineHighlight.name());
+    ).arg(background, foreground, selection, lineNumber, lineHighlight);
     
+    styleSheetCache.insert(key, stylesheet);
     return stylesheet;
 }
 
 void ThemeManager::applyTheme(const EditorTheme &theme) const
 {
-    // Install stylesheet
-    qApp->setStyleSheet(toStyleSheet(theme));
+    applyStyleSheet(theme);
+    applyPalette(theme);
+}
 
+void ThemeManager::applyStyleSheet(const EditorTheme &theme) const
+{
+    // This is the only place a theme sheet is set: setting it again, or on
+    // individual widgets, makes Qt re-parse it and re-polish every widget
+    // it reaches.
+    const QString stylesheet = toStyleSheet(theme);
+    if (qApp->styleSheet() != stylesheet) {
+        qApp->setStyleSheet(stylesheet);
+    }
+}
+
+void ThemeManager::applyPalette(const EditorTheme &theme) const
+{
     // Build and apply a QPalette that matches the theme so native widgets
-    // and style elements render with correct colors.
+    // and style elements render with correct colors. Cheap compared to the
+    // stylesheet, so the theme dialog uses it alone for live previews.
     QPalette pal;
     pal.setColor(QPalette::Window, theme.background);
     pal.setColor(QPalette::WindowText, theme.foreground);
@@ -308,7 +583,9 @@ void ThemeManager::applyTheme(const EditorTheme &theme) const
     pal.setColor(QPalette::ToolTipBase, theme.lineHighlight);
     pal.setColor(QPalette::ToolTipText, theme.foreground);
 
-    qApp->setPalette(pal);
+    if (qApp->palette() != pal) {
+        qApp->setPalette(pal);
+    }
 }
 
 EditorTheme ThemeManager::loadThemeFromJson(const QString &themeName) const
@@ -318,37 +595,15 @@ EditorTheme ThemeManager::loadThemeFromJson(const QString &themeName) const
         return themes.value("Light", themes.value("Dracula"));
     }
     
-    // Find the JSON file with this theme name
-    QDir dir(themesDir);
-    QStringList filters;
-    filters << "*.json";
-    
-    QFileInfoList files = dir.entryInfoList(filters, QDir::Files | QDir::Readable);
-    
-    QString targetFile;
-    for (const QFileInfo &fileInfo : files) {
-        QFile file(fileInfo.absoluteFilePath());
-        if (file.open(QIODevice::ReadOnly)) {
-            QByteArray data = file.readAll();
-            file.close();
-            
-            QJsonDocument doc = QJsonDocument::fromJson(data);
-            if (doc.isObject()) {
-                QJsonObject obj = doc.object();
-                if (obj["name"].toString() == themeName) {
-                    targetFile = fileInfo.absoluteFilePath();
-                    break;
-                }
-            }
-        }
-    }
+    // The index maps the theme name straight to its file
+    QString targetFile = themeIndex.value(themeName).filePath;
     
     if (targetFile.isEmpty()) {
         qWarning() << "Theme file not found for:" << themeName;
         return themes.value("Light", themes.value("Dracula"));
     }
     
-    // Re-open and parse the file
+    // Open and parse the file
     QFile file(targetFile);
     if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "Failed to open theme file:" << targetFile;
@@ -418,57 +673,7 @@ EditorTheme ThemeManager::parseJsonTheme(const QJsonObject &obj) const
             theme.foreground = QColor("#FFFFFF");
         }
         
-        // Set selection color (slightly lighter/darker than background)
-        QColor bg = theme.background;
-        int selectionLightness = bg.lightness() + (bg.lightness() < 128 ? 20 : -20);
-        selectionLightness = qBound(0, selectionLightness, 255);
-        
-        // For grayscale colors (hue = -1), use RGB manipulation instead of HSL
-        if (bg.hue() == -1) {
-            int r = qBound(0, bg.red() + (bg.lightness() < 128 ? 20 : -20), 255);
-            int g = qBound(0, bg.green() + (bg.lightness() < 128 ? 20 : -20), 255);
-            int b = qBound(0, bg.blue() + (bg.lightness() < 128 ? 20 : -20), 255);
-            theme.selection = QColor(r, g, b);
-        } else {
-            theme.selection = QColor::fromHsl(bg.hue(), bg.saturation(), selectionLightness);
-        }
-        
-        // Validate selection color
-        if (!theme.selection.isValid()) {
-            qWarning() << "Invalid selection color calculated, using fallback";
-            theme.selection = QColor(bg.red() + 20, bg.green() + 20, bg.blue() + 20);
-        }
-        
-        // Set line highlight (slightly different from background)
-        int lineHighlightLightness = bg.lightness() + (bg.lightness() < 128 ? 10 : -10);
-        lineHighlightLightness = qBound(0, lineHighlightLightness, 255);
-        
-        if (bg.hue() == -1) {
-            int r = qBound(0, bg.red() + (bg.lightness() < 128 ? 10 : -10), 255);
-            int g = qBound(0, bg.green() + (bg.lightness() < 128 ? 10 : -10), 255);
-            int b = qBound(0, bg.blue() + (bg.lightness() < 128 ? 10 : -10), 255);
-            theme.lineHighlight = QColor(r, g, b);
-        } else {
-            theme.lineHighlight = QColor::fromHsl(bg.hue(), bg.saturation(), lineHighlightLightness);
-        }
-        
-        // Validate line highlight color
-        if (!theme.lineHighlight.isValid()) {
-            qWarning() << "Invalid line highlight color calculated, using fallback";
-            theme.lineHighlight = QColor(bg.red() + 10, bg.green() + 10, bg.blue() + 10);
-        }
-        
-        // Set line number colors
-        theme.lineNumber = theme.color_09; // Bright black
-        theme.lineNumberBg = theme.background;
-        
-        // Map ANSI colors to syntax highlighting
-        theme.keyword = theme.color_06;   // Magenta - keywords
-        theme.function = theme.color_03;  // Green - functions
-        theme.string = theme.color_04;    // Yellow - strings
-        theme.number = theme.color_05;    // Blue - numbers
-        theme.comment = theme.color_09;   // Bright black - comments
-        theme.operator_ = theme.color_02; // Red - operators
+        deriveEditorColors(theme);
         
     } catch (const std::exception &e) {
         qWarning() << "Exception parsing theme:" << e.what();
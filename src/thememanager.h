@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QString>
 #include <QMap>
+#include <QHash>
 #include <QColor>
 #include <QDir>
 
@@ -49,15 +50,38 @@ public:
     QString toStyleSheet(const EditorTheme &theme) const;
     void applyTheme(const EditorTheme &theme) const;
     
+    // The two halves of applyTheme, for callers that need to stage them
+    void applyStyleSheet(const EditorTheme &theme) const;
+    void applyPalette(const EditorTheme &theme) const;
+    
 private:
+    // One entry of the persisted theme index: where the theme lives, the
+    // file's mtime when it was parsed, and the parsed colors themselves
+    struct ThemeIndexEntry {
+        QString filePath;
+        qint64 modified = 0;
+        EditorTheme theme;
+    };
+
+    // The tests build their own instances over scratch theme files
+    friend class TestCore;
+
     ThemeManager();
     void initializeThemes();
     void scanJsonThemes();
     QString findThemesDirectory() const;
+    bool hasTheme(const QString &name) const;
+    QString themeIndexPath() const;
+    bool loadThemeIndex();
+    void buildThemeIndex();
+    void saveThemeIndex() const;
     EditorTheme loadThemeFromJson(const QString &themeName) const;
     EditorTheme parseJsonTheme(const QJsonObject &obj) const;
     
     QMap<QString, EditorTheme> themes;
+    QHash<QString, ThemeIndexEntry> themeIndex;
+    QHash<QString, int> bundledIndex;
+    mutable QHash<QString, QString> styleSheetCache;
     QStringList jsonThemeNames;
     QString themesDir;
     QString currentThemeName;
@@ -0,0 +1,1085 @@
+#include <QtTest>
+#include <QAbstractItemModelTester>
+#include <QApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QSortFilterProxyModel>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include "bundledthemes.h"
+#include "codeeditor.h"
+#include "environmentmodel.h"
+#include "fileloader.h"
+#include "rlexer.h"
+#include "sessionchannel.h"
+#include "sessionstate.h"
+#include "sharedcolumns.h"
+#include "thememanager.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *kindName(RLexer::TokenKind kind)
+{
+    switch (kind) {
+    case RLexer::Keyword: return "Keyword";
+    case RLexer::Function: return "Function";
+    case RLexer::Number: return "Number";
+    case RLexer::String: return "String";
+    case RLexer::Comment: return "Comment";
+    case RLexer::Operator: return "Operator";
+    case RLexer::TokenKindCount: break;
+    }
+    return "?";
+}
+
+// Tokens of one line as "Kind:text", which reads well in a failure
+QStringList describeTokens(const QString &line, int &state)
+{
+    QStringList out;
+    const QVector<RLexer::Token> tokens = RLexer::tokenize(line, state);
+    for (const RLexer::Token &token : tokens) {
+        out << QString("%1:%2").arg(kindName(token.kind), line.mid(token.start, token.length));
+    }
+    return out;
+}
+
+// Message encoding as qide writes it (see qiderpkg/R/core.R)
+void writeString(QDataStream &out, const QString &value)
+{
+    const QByteArray bytes = value.toUtf8();
+    out << quint32(bytes.size());
+    out.writeRawData(bytes.constData(), int(bytes.size()));
+}
+
+void writeEntries(QDataStream &out, const QVector<EnvironmentEntry> &entries)
+{
+    out << quint32(entries.size());
+    for (const EnvironmentEntry &entry : entries) {
+        writeString(out, entry.name);
+        writeString(out, entry.type);
+        out << quint32(entry.dim.size());
+        for (double d : entry.dim) {
+            out << d;
+        }
+        out << entry.length << entry.size << quint8(entry.expandable ? 1 : 0);
+    }
+}
+
+QByteArray encodeSnapshot(const QVector<EnvironmentEntry> &entries)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out << 1e9;
+    writeEntries(out, entries);
+    return payload;
+}
+
+QByteArray encodeDelta(const QStringList &removed, const QVector<EnvironmentEntry> &entries)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out << 1e9 << quint32(removed.size());
+    for (const QString &name : removed) {
+        writeString(out, name);
+    }
+    writeEntries(out, entries);
+    return payload;
+}
+
+EnvironmentEntry object(const QString &name, double size)
+{
+    EnvironmentEntry entry;
+    entry.name = name;
+    entry.type = "numeric";
+    entry.length = 10;
+    entry.size = size;
+    return entry;
+}
+
+// Many small objects and a few large data frames, as a simulation
+// workflow leaves behind
+QVector<EnvironmentEntry> workspace(int count)
+{
+    QVector<EnvironmentEntry> entries;
+    entries.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        EnvironmentEntry entry = object(QString("obj%1").arg(i), 176);
+        if (i % 2500 == 0) {
+            entry.type = "data.frame";
+            entry.dim = {1e6, 20};
+            entry.length = 20;
+            entry.size = 1.6e8;
+            entry.expandable = true;
+        }
+        entries << entry;
+    }
+    return entries;
+}
+
+int rowOf(const EnvironmentModel &model, const QString &name)
+{
+    for (int row = 0; row < model.rowCount(); ++row) {
+        if (model.index(row, EnvironmentModel::NameColumn).data().toString() == name) return row;
+    }
+    return -1;
+}
+
+// User themes directory and theme index of a ThemeManager, created for
+// one test and removed with everything in them afterwards
+struct UserThemes {
+    const QString path = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/themes";
+    const QString index = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+                              .filePath("theme-index.bin");
+
+    UserThemes() { QDir().mkpath(path); }
+    ~UserThemes()
+    {
+        QDir(path).removeRecursively();
+        QFile::remove(index);
+    }
+
+    QString file(const QString &name) const { return QDir(path).filePath(name); }
+};
+
+bool writeJson(const QString &path, const QJsonObject &object)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        && file.write(QJsonDocument(object).toJson()) > 0;
+}
+
+QJsonObject themeJson(const QString &name, const QString &background)
+{
+    return QJsonObject{{"name", name}, {"author", "test"}, {"variant", "dark"},
+                       {"background", background}, {"foreground", "#f8f8f2"}};
+}
+
+// A bundled theme as the Gogh JSON file it was generated from
+QJsonObject themeJson(const BundledTheme &bundled)
+{
+    static const char *const keys[BundledTheme::ColorCount] = {
+        "background", "foreground", "cursor",
+        "color_01", "color_02", "color_03", "color_04", "color_05", "color_06", "color_07", "color_08",
+        "color_09", "color_10", "color_11", "color_12", "color_13", "color_14", "color_15", "color_16"};
+    QJsonObject object{{"name", QString::fromUtf8(bundled.name)},
+                       {"author", QString::fromUtf8(bundled.author)},
+                       {"variant", QString::fromUtf8(bundled.variant)}};
+    for (int i = 0; i < BundledTheme::ColorCount; ++i) {
+        if (bundled.colors[i] >= 0) object.insert(keys[i], QColor(QRgb(bundled.colors[i])).name());
+    }
+    return object;
+}
+
+// ThemeManager compares mtimes in milliseconds, which a test writing files
+// back to back cannot rely on changing; set them outright
+bool setModified(const QString &path, qint64 msecs)
+{
+#ifdef Q_OS_UNIX
+    const struct timeval time = {time_t(msecs / 1000), suseconds_t(msecs % 1000 * 1000)};
+    const struct timeval times[2] = {time, time};
+    return utimes(QFile::encodeName(path).constData(), times) == 0;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(msecs);
+    return false;
+#endif
+}
+
+// A page of one numeric or one character column, in the three forms Q
+// can receive it in
+struct Column {
+    bool numeric = true;
+    QVector<double> numbers;
+    QStringList strings;
+
+    int rows() const { return int(numeric ? numbers.size() : strings.size()); }
+};
+
+Column makeColumn(bool numeric, int rows)
+{
+    Column column;
+    column.numeric = numeric;
+    for (int i = 0; i < rows; ++i) {
+        if (numeric) {
+            column.numbers << i * 1.25;
+        } else {
+            column.strings << QString("level-%1").arg(i % 1000);
+        }
+    }
+    return column;
+}
+
+QByteArray encodeJson(const Column &column)
+{
+    QJsonArray array;
+    for (int i = 0; i < column.rows(); ++i) {
+        if (column.numeric) {
+            array.append(column.numbers.at(i));
+        } else {
+            array.append(column.strings.at(i));
+        }
+    }
+    return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+// TableRowsMessage payload, cells formatted by R
+QByteArray encodeTextRows(const Column &column)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out << quint32(1) << quint32(1) << 0.0 << quint32(0) << quint32(column.rows()) << quint32(1);
+
+    QByteArray bytes;
+    for (int i = 0; i < column.rows(); ++i) {
+        const QByteArray cell = column.numeric
+            ? QByteArray::number(column.numbers.at(i), 'g', 7)
+            : column.strings.at(i).toUtf8();
+        out << quint32(cell.size());
+        bytes += cell;
+    }
+    out.writeRawData(bytes.constData(), int(bytes.size()));
+    return payload;
+}
+
+quint64 align8(quint64 n)
+{
+    return (n + 7) & ~quint64(7);
+}
+
+// Segment image laid out as qiderpkg/src/columns.c writes it. Rows in
+// missing are NA.
+QByteArray encodeSegment(const Column &column, const QSet<int> &missing = {})
+{
+    const quint64 rows = quint64(column.rows());
+    const quint64 validity = align8(16 + 32);
+    const quint64 validityBytes = align8((rows + 7) / 8);
+    quint64 data = validity + validityBytes;
+    quint64 offsets = 0;
+    QByteArray strings;
+    QVector<quint64> stringOffsets;
+    if (!column.numeric) {
+        offsets = data;
+        data = offsets + align8((rows + 1) * 8);
+        stringOffsets << 0;
+        for (const QString &value : column.strings) {
+            strings += value.toUtf8();
+            stringOffsets << quint64(strings.size());
+        }
+    }
+    const quint64 size = data + align8(column.numeric ? rows * 8 : quint64(strings.size()));
+
+    QByteArray image(qsizetype(size), '\0');
+    char *p = image.data();
+    const quint32 header[4] = {0x4c4f4351, 1, quint32(rows), 1};
+    std::memcpy(p, header, sizeof(header));
+    const quint32 type = column.numeric ? 1 : 4;
+    std::memcpy(p + 16, &type, 4);
+    std::memcpy(p + 24, &data, 8);
+    std::memcpy(p + 32, &validity, 8);
+    std::memcpy(p + 40, &offsets, 8);
+
+    uchar *bits = reinterpret_cast<uchar*>(p + validity);
+    for (quint64 row = 0; row < rows; ++row) {
+        if (!missing.contains(int(row))) bits[row >> 3] |= uchar(1u << (row & 7));
+    }
+    if (column.numeric) {
+        std::memcpy(p + data, column.numbers.constData(), rows * 8);
+    } else {
+        std::memcpy(p + offsets, stringOffsets.constData(), (rows + 1) * 8);
+        std::memcpy(p + data, strings.constData(), size_t(strings.size()));
+    }
+    return image;
+}
+
+// Puts an image into a new POSIX shared-memory segment and maps it back
+// the way SessionChannel does for TableRowsSharedMessage
+std::shared_ptr<SharedColumns> shareSegment(const QByteArray &image)
+{
+#ifdef Q_OS_UNIX
+    static int counter = 0;
+    const QString name = QString("/qide-test-%1-%2").arg(QCoreApplication::applicationPid()).arg(++counter);
+    const QByteArray path = name.toLocal8Bit();
+    const int fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, off_t(image.size())) == 0) {
+        mapping = mmap(nullptr, size_t(image.size()), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(path.constData());
+        return nullptr;
+    }
+    std::memcpy(mapping, image.constData(), size_t(image.size()));
+    munmap(mapping, size_t(image.size()));
+    return SharedColumns::open(name, image.size());
+#else
+    Q_UNUSED(image);
+    return nullptr;
+#endif
+}
+
+// Stands in for qide inside R: connects to a SessionChannel, collects
+// the pings Q sends and answers them
+struct FakeR {
+    QLocalSocket socket;
+    QByteArray buffer;
+    QVector<quint32> pings;
+
+    // Reads what has arrived; returns the number of pings so far
+    int poll()
+    {
+        buffer += socket.readAll();
+        while (buffer.size() >= 5) {
+            const quint32 length = qFromLittleEndian<quint32>(buffer.constData());
+            if (quint32(buffer.size()) < 5 + length) break;
+            const quint8 type = quint8(buffer.at(4));
+            if (type == SessionChannel::PingMessage && length == 4) {
+                pings << qFromLittleEndian<quint32>(buffer.constData() + 5);
+            }
+            buffer.remove(0, 5 + length);
+        }
+        return pings.size();
+    }
+
+    void answer(quint32 sequence)
+    {
+        char frame[9];
+        qToLittleEndian<quint32>(4, frame);
+        frame[4] = char(SessionChannel::IdleMessage);
+        qToLittleEndian<quint32>(sequence, frame + 5);
+        socket.write(frame, sizeof(frame));
+        socket.flush();
+    }
+};
+
+} // namespace
+
+// Correctness checks and benchmarks for the pieces of Q that the
+// performance work touched. Benchmarks report through QBENCHMARK; run
+// with -tickcounter or -iterations for steadier numbers.
+class TestCore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    // RLexer
+    void tokenize_data();
+    void tokenize();
+    void tokenizeAcrossLines();
+    void benchmarkTokenize();
+
+    // ThemeManager
+    void bundledThemesAreCompiledIn();
+    void benchmarkThemeLookup();
+    void themeSwitchStylesOnlyTheApplication();
+    void benchmarkThemeSwitch_data();
+    void benchmarkThemeSwitch();
+    void themeIndexFollowsDirectory();
+    void themeIndexRereadsChangedFilesOnly();
+    void themeIndexRejectsCorruptFile();
+    void benchmarkThemeStartup_data();
+    void benchmarkThemeStartup();
+
+    // Environment messages and EnvironmentModel
+    void environmentDelta();
+    void environmentModelSortsBySize();
+    void removingRowsKeepsParentsCurrent();
+    void sizeArrivingKeepsChildren();
+    void benchmarkEnvironmentUpdate_data();
+    void benchmarkEnvironmentUpdate();
+
+    // Data viewer pages: JSON, text frames and shared memory
+    void sharedColumnsMatchText();
+    void benchmarkPageTransfer_data();
+    void benchmarkPageTransfer();
+
+    // Chunked file loading
+    void truncatedUtf8AtEndIsShown();
+
+    // Busy/idle tracking of the R session
+    void sessionIdleNeedsConfirmedPing();
+
+private:
+    QTemporaryDir settingsDir;
+};
+
+void TestCore::initTestCase()
+{
+    // Keep the user's settings and theme directory out of the tests
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(settingsDir.isValid());
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, settingsDir.path());
+}
+
+void TestCore::tokenize_data()
+{
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<QStringList>("tokens");
+
+    QTest::newRow("numbers")
+        << "x <- 0x1FL + 2.5e-3 * 3i"
+        << QStringList{"Operator:<-", "Number:0x1FL", "Operator:+", "Number:2.5e-3",
+                       "Operator:*", "Number:3i"};
+    QTest::newRow("hash in string")
+        << "s <- \"# not a comment\" # if in a comment"
+        << QStringList{"Operator:<-", "String:\"# not a comment\"", "Comment:# if in a comment"};
+    QTest::newRow("keywords and functions")
+        << "if (x %in% y) f(x) else NULL"
+        << QStringList{"Keyword:if", "Operator:%in%", "Function:f", "Keyword:else", "Keyword:NULL"};
+    QTest::newRow("pipe and lambda")
+        << "x |> sapply(\\(v) v^2)"
+        << QStringList{"Operator:|>", "Function:sapply", "Keyword:\\", "Operator:^", "Number:2"};
+    QTest::newRow("backtick function")
+        << "`my fun`(1)"
+        << QStringList{"Function:`my fun`", "Number:1"};
+    QTest::newRow("raw string")
+        << "r\"(a \"quoted\" (string))\""
+        << QStringList{"String:r\"(a \"quoted\" (string))\""};
+    QTest::newRow("dashed raw string")
+        << "R'--[x]-' ]--'"
+        << QStringList{"String:R'--[x]-' ]--'"};
+}
+
+void TestCore::tokenize()
+{
+    QFETCH(QString, line);
+    QFETCH(QStringList, tokens);
+
+    int state = RLexer::Normal;
+    QCOMPARE(describeTokens(line, state), tokens);
+    QCOMPARE(state, int(RLexer::Normal));
+}
+
+void TestCore::tokenizeAcrossLines()
+{
+    int state = RLexer::Normal;
+    QCOMPARE(describeTokens("x <- r\"[first", state), (QStringList{"Operator:<-", "String:r\"[first"}));
+    QCOMPARE(state & RLexer::StateKindMask, int(RLexer::InRawString));
+
+    // A quote alone does not close a raw string, the bracket does
+    QCOMPARE(describeTokens("still \" inside", state), QStringList{"String:still \" inside"});
+    QCOMPARE(state & RLexer::StateKindMask, int(RLexer::InRawString));
+
+    QCOMPARE(describeTokens("last]\"; y <- 'open", state),
+             (QStringList{"String:last]\"", "Operator:<-", "String:'open"}));
+    QCOMPARE(state, int(RLexer::InSingleString));
+
+    QCOMPARE(describeTokens("closed' # done", state), (QStringList{"String:closed'", "Comment:# done"}));
+    QCOMPARE(state, int(RLexer::Normal));
+}
+
+void TestCore::benchmarkTokenize()
+{
+    // Cost per block, for a line with a bit of everything
+    const QString line = "result <- lapply(seq_len(n), \\(i) if (x[i] %in% y) f(i, \"a#b\") else 0x1FL) # note";
+    QBENCHMARK {
+        int state = RLexer::Normal;
+        RLexer::tokenize(line, state);
+    }
+}
+
+void TestCore::bundledThemesAreCompiledIn()
+{
+    // No theme directory exists in test mode, so every theme here comes
+    // from the table compiled into the binary
+    const ThemeManager &themes = ThemeManager::instance();
+    const QStringList names = themes.availableThemes();
+    QVERIFY(names.size() > 100);
+    for (const QString &name : names) {
+        const EditorTheme theme = themes.getTheme(name);
+        QCOMPARE(theme.name, name);
+        QVERIFY2(theme.background.isValid() && theme.foreground.isValid(), qPrintable(name));
+    }
+}
+
+void TestCore::benchmarkThemeLookup()
+{
+    const ThemeManager &themes = ThemeManager::instance();
+    const QStringList names = themes.availableThemes();
+    QBENCHMARK {
+        for (const QString &name : names) {
+            themes.getTheme(name);
+        }
+    }
+}
+
+void TestCore::themeSwitchStylesOnlyTheApplication()
+{
+    ThemeManager &themes = ThemeManager::instance();
+    const QStringList names = themes.availableThemes();
+    QVERIFY(names.size() >= 2);
+
+    CodeEditor editor;
+    for (const QString &name : names.mid(0, 2)) {
+        themes.setCurrentTheme(name);
+        const EditorTheme theme = themes.currentTheme();
+        editor.setTheme(theme);
+
+        // One sheet for the whole application, none per editor, so a
+        // switch re-polishes each widget once
+        QCOMPARE(qApp->styleSheet(), themes.toStyleSheet(theme));
+        QVERIFY(editor.styleSheet().isEmpty());
+    }
+}
+
+void TestCore::benchmarkThemeSwitch_data()
+{
+    QTest::addColumn<int>("tabs");
+    QTest::newRow("1 tab") << 1;
+    QTest::newRow("10 tabs") << 10;
+    QTest::newRow("30 tabs") << 30;
+}
+
+void TestCore::benchmarkThemeSwitch()
+{
+    QFETCH(int, tabs);
+
+    QStringList lines;
+    for (int i = 0; i < 2000; ++i) {
+        lines << QString("x%1 <- f(\"value\", %1L) # line %1").arg(i);
+    }
+    const QString text = lines.join('\n');
+
+    QWidget window;
+    QList<CodeEditor*> editors;
+    for (int i = 0; i < tabs; ++i) {
+        CodeEditor *editor = new CodeEditor(&window);
+        editor->setPlainText(text);
+        editors << editor;
+    }
+
+    // What the user waits for: the application sheet and each editor's
+    // formats. Re-coloring beyond the visible blocks happens later, from
+    // the event loop.
+    ThemeManager &themes = ThemeManager::instance();
+    const QStringList names = themes.availableThemes().mid(0, 2);
+    int next = 0;
+    QBENCHMARK {
+        themes.setCurrentTheme(names.at(next++ % names.size()));
+        const EditorTheme theme = themes.currentTheme();
+        for (CodeEditor *editor : std::as_const(editors)) {
+            editor->setTheme(theme);
+        }
+    }
+}
+
+void TestCore::themeIndexFollowsDirectory()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("Sets file times with utimes()");
+#endif
+    UserThemes user;
+    const qint64 time = QDateTime::currentMSecsSinceEpoch() - 60000;
+    QVERIFY(writeJson(user.file("a.json"), themeJson("Test A", "#101010")));
+    QVERIFY(setModified(user.file("a.json"), time));
+    QVERIFY(setModified(user.path, time));
+    {
+        ThemeManager themes;
+        QVERIFY(themes.availableThemes().contains("Test A"));
+    }
+    QVERIFY(QFile::exists(user.index));
+
+    // While the directory mtime matches, startup trusts the index
+    QVERIFY(writeJson(user.file("b.json"), themeJson("Test B", "#202020")));
+    QVERIFY(setModified(user.path, time));
+    {
+        ThemeManager themes;
+        QVERIFY(themes.availableThemes().contains("Test A"));
+        QVERIFY(!themes.availableThemes().contains("Test B"));
+    }
+
+    // A stale directory mtime rebuilds it
+    QVERIFY(setModified(user.path, time + 1000));
+    ThemeManager themes;
+    QVERIFY(themes.availableThemes().contains("Test B"));
+    QCOMPARE(themes.getTheme("Test B").background, QColor("#202020"));
+}
+
+void TestCore::themeIndexRereadsChangedFilesOnly()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("Sets file times with utimes()");
+#endif
+    UserThemes user;
+    const qint64 time = QDateTime::currentMSecsSinceEpoch() - 60000;
+    QVERIFY(writeJson(user.file("a.json"), themeJson("Test A", "#101010")));
+    QVERIFY(writeJson(user.file("b.json"), themeJson("Test B", "#202020")));
+    QVERIFY(setModified(user.file("a.json"), time));
+    QVERIFY(setModified(user.file("b.json"), time));
+    QVERIFY(setModified(user.path, time));
+    {
+        ThemeManager themes;
+    }
+
+    // Both files are edited in place, but only a's mtime moves; b still
+    // showing its indexed colors proves its file was not read again
+    QVERIFY(writeJson(user.file("a.json"), themeJson("Test A", "#111111")));
+    QVERIFY(writeJson(user.file("b.json"), themeJson("Test B", "#222222")));
+    QVERIFY(setModified(user.file("a.json"), time + 1000));
+    QVERIFY(setModified(user.file("b.json"), time));
+    QVERIFY(setModified(user.path, time));
+
+    ThemeManager themes;
+    QCOMPARE(themes.getTheme("Test A").background, QColor("#111111"));
+    QCOMPARE(themes.getTheme("Test B").background, QColor("#202020"));
+}
+
+void TestCore::themeIndexRejectsCorruptFile()
+{
+    UserThemes user;
+    QVERIFY(writeJson(user.file("a.json"), themeJson("Test A", "#101010")));
+    {
+        ThemeManager themes;
+    }
+    const qint64 size = QFileInfo(user.index).size();
+    QVERIFY(size > 0);
+
+    // Cut short in the middle of the entries
+    QVERIFY(QFile::resize(user.index, size / 2));
+    {
+        ThemeManager themes;
+        QCOMPARE(themes.getTheme("Test A").background, QColor("#101010"));
+    }
+    QCOMPARE(QFileInfo(user.index).size(), size);
+
+    // Not an index at all
+    QVERIFY(writeJson(user.index, themeJson("Not an index", "#000000")));
+    {
+        ThemeManager themes;
+        QCOMPARE(themes.getTheme("Test A").background, QColor("#101010"));
+    }
+    QCOMPARE(QFileInfo(user.index).size(), size);
+}
+
+void TestCore::benchmarkThemeStartup_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::newRow("before: parse every Gogh JSON file") << "json";
+    QTest::newRow("after: compiled table") << "table";
+    QTest::newRow("user themes from the binary index") << "index";
+}
+
+void TestCore::benchmarkThemeStartup()
+{
+    QFETCH(QString, source);
+
+    // Constructing ThemeManager is its share of startup. Before the themes
+    // were compiled in, startup parsed all of them from JSON; the same
+    // files in the user directory with no index reproduce that (plus
+    // writing the index once).
+    std::unique_ptr<UserThemes> user;
+    if (source != "table") {
+        user = std::make_unique<UserThemes>();
+        for (int i = 0; i < bundledThemeCount; ++i) {
+            QVERIFY(writeJson(user->file(QString("%1.json").arg(i)), themeJson(bundledThemes[i])));
+        }
+    }
+    if (source == "index") {
+        ThemeManager writesIndex;
+        QVERIFY(QFile::exists(user->index));
+    }
+
+    QBENCHMARK {
+        if (source == "json") QFile::remove(user->index);
+        ThemeManager themes;
+    }
+}
+
+void TestCore::environmentDelta()
+{
+    EnvironmentSnapshot snapshot;
+    QVERIFY(SessionChannel::decodeEnvironment(encodeSnapshot(workspace(10000)), snapshot));
+    EnvironmentModel model;
+    model.setSnapshot(snapshot);
+    QCOMPARE(model.rowCount(), 10000);
+
+    EnvironmentDelta delta;
+    QVERIFY(SessionChannel::decodeEnvironmentDelta(
+        encodeDelta({"obj1", "obj5000", "obj9999"},
+                    {object("obj2", 2048), object("new1", 100), object("new2", -1)}),
+        delta));
+    QCOMPARE(delta.removed.size(), 3);
+    QCOMPARE(delta.entries.size(), 3);
+
+    // Rows stay put: only the named ones are touched, new ones go last
+    const int row2 = rowOf(model, "obj2");
+    model.applyDelta(delta);
+    QCOMPARE(model.rowCount(), 10000 - 3 + 2);
+    QCOMPARE(rowOf(model, "obj1"), -1);
+    QCOMPARE(rowOf(model, "obj5000"), -1);
+    QCOMPARE(rowOf(model, "obj9999"), -1);
+    QCOMPARE(rowOf(model, "obj2"), row2 - 1);
+    QCOMPARE(model.index(row2 - 1, EnvironmentModel::SizeColumn).data().toString(), QString("2.00 KB"));
+    QCOMPARE(rowOf(model, "new1"), model.rowCount() - 2);
+    QCOMPARE(rowOf(model, "new2"), model.rowCount() - 1);
+    QVERIFY(model.hasPendingSizes());
+}
+
+void TestCore::environmentModelSortsBySize()
+{
+    EnvironmentModel model;
+    QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QSortFilterProxyModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.setSortRole(EnvironmentModel::SortRole);
+    proxy.setDynamicSortFilter(true);
+    proxy.sort(EnvironmentModel::SizeColumn, Qt::DescendingOrder);
+    QAbstractItemModelTester proxyTester(&proxy, QAbstractItemModelTester::FailureReportingMode::QtTest);
+
+    // "9 B" sorts above "10 B" as text; the sort role keeps it numeric
+    QVector<EnvironmentEntry> entries;
+    for (int i = 0; i < 100; ++i) {
+        entries << object(QString("obj%1").arg(i), i + 1);
+    }
+    EnvironmentSnapshot snapshot;
+    snapshot.entries = entries;
+    model.setSnapshot(snapshot);
+    auto topName = [&proxy]() {
+        return proxy.index(0, EnvironmentModel::NameColumn).data().toString();
+    };
+    QCOMPARE(topName(), QString("obj99"));
+
+    EnvironmentDelta delta;
+    delta.removed = QStringList{"obj99", "obj50"};
+    delta.entries = {object("obj0", 1e6), object("big", 1e5)};
+    model.applyDelta(delta);
+    QCOMPARE(model.rowCount(), 100);
+    QCOMPARE(topName(), QString("obj0"));
+    QCOMPARE(proxy.index(1, EnvironmentModel::NameColumn).data().toString(), QString("big"));
+}
+
+void TestCore::removingRowsKeepsParentsCurrent()
+{
+    EnvironmentModel model;
+    QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QList<quint32> requests;
+    connect(&model, &EnvironmentModel::childrenRequested, this, [&requests](quint32 id) {
+        requests << id;
+    });
+
+    EnvironmentSnapshot snapshot;
+    for (int i = 0; i < 10; ++i) {
+        EnvironmentEntry entry = object(QString("l%1").arg(i), 1000);
+        entry.type = "list";
+        entry.expandable = true;
+        snapshot.entries << entry;
+    }
+    model.setSnapshot(snapshot);
+    for (int row = 0; row < model.rowCount(); ++row) {
+        model.fetchMore(model.index(row, 0));
+    }
+    QCOMPARE(requests.size(), 10);
+    for (quint32 id : std::as_const(requests)) {
+        EnvironmentChildren children;
+        children.requestId = id;
+        children.total = 2;
+        children.keys = QStringList{"1", "2"};
+        children.entries = {object("[[1]]", 56), object("[[2]]", 56)};
+        model.addChildren(children);
+    }
+
+    // Views map the children of the rows below a removed run to their
+    // parent while handling the signal, so parent() must be current then
+    int stale = 0;
+    connect(&model, &QAbstractItemModel::rowsRemoved, this, [&model, &stale](const QModelIndex &parent) {
+        if (parent.isValid()) return;
+        for (int row = 0; row < model.rowCount(); ++row) {
+            const QModelIndex child = model.index(0, 0, model.index(row, 0));
+            if (!child.isValid() || model.parent(child).row() != row) ++stale;
+        }
+    });
+
+    // Three runs: l1-l2, l5 and l8
+    EnvironmentDelta delta;
+    delta.removed = QStringList{"l1", "l2", "l5", "l8"};
+    model.applyDelta(delta);
+    QCOMPARE(stale, 0);
+    QCOMPARE(model.rowCount(), 6);
+    const QStringList expected{"l0", "l3", "l4", "l6", "l7", "l9"};
+    for (int row = 0; row < model.rowCount(); ++row) {
+        const QModelIndex index = model.index(row, 0);
+        QCOMPARE(index.data().toString(), expected.at(row));
+        QCOMPARE(model.rowCount(index), 2);
+        QCOMPARE(model.parent(model.index(1, 0, index)), index);
+    }
+}
+
+void TestCore::sizeArrivingKeepsChildren()
+{
+    EnvironmentModel model;
+    QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QList<quint32> requests;
+    connect(&model, &EnvironmentModel::childrenRequested, this, [&requests](quint32 id) {
+        requests << id;
+    });
+
+    EnvironmentEntry entry = object("l", -1);
+    entry.type = "list";
+    entry.expandable = true;
+    EnvironmentSnapshot snapshot;
+    snapshot.entries << entry;
+    model.setSnapshot(snapshot);
+    QVERIFY(model.hasPendingSizes());
+
+    const QModelIndex list = model.index(0, 0);
+    model.fetchMore(list);
+    QCOMPARE(requests.size(), 1);
+    EnvironmentChildren children;
+    children.requestId = requests.first();
+    children.total = 2;
+    children.keys = QStringList{"1", "2"};
+    children.entries = {object("[[1]]", 56), object("[[2]]", 56)};
+    model.addChildren(children);
+    QCOMPARE(model.rowCount(list), 2);
+
+    // The size alone arrives: nothing is removed or fetched again
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    entry.size = 4096;
+    EnvironmentDelta delta;
+    delta.entries << entry;
+    model.applyDelta(delta);
+    QVERIFY(!model.hasPendingSizes());
+    QCOMPARE(removed.count(), 0);
+    QCOMPARE(requests.size(), 1);
+    QCOMPARE(model.rowCount(list), 2);
+    QCOMPARE(model.index(0, EnvironmentModel::SizeColumn).data().toString(), EnvironmentModel::formatSize(4096));
+
+    // A changed object still loses its stale children
+    entry.length = 3;
+    delta.entries = {entry};
+    model.applyDelta(delta);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(requests.size(), 2);
+}
+
+void TestCore::benchmarkEnvironmentUpdate_data()
+{
+    QTest::addColumn<bool>("full");
+    QTest::newRow("snapshot of 10k objects") << true;
+    QTest::newRow("delta of 10 in 10k objects") << false;
+}
+
+void TestCore::benchmarkEnvironmentUpdate()
+{
+    QFETCH(bool, full);
+
+    const QVector<EnvironmentEntry> entries = workspace(10000);
+    const QByteArray snapshotPayload = encodeSnapshot(entries);
+    EnvironmentModel model;
+    EnvironmentSnapshot snapshot;
+    QVERIFY(SessionChannel::decodeEnvironment(snapshotPayload, snapshot));
+    model.setSnapshot(snapshot);
+
+    QVector<EnvironmentEntry> changed;
+    for (int i = 0; i < 10; ++i) {
+        changed << object(QString("obj%1").arg(i * 997 + 1), 352);
+    }
+    const QByteArray deltaPayload = encodeDelta({}, changed);
+
+    // Decoding and applying, what Q does per message after each command
+    QBENCHMARK {
+        if (full) {
+            EnvironmentSnapshot next;
+            SessionChannel::decodeEnvironment(snapshotPayload, next);
+            model.setSnapshot(next);
+        } else {
+            EnvironmentDelta delta;
+            SessionChannel::decodeEnvironmentDelta(deltaPayload, delta);
+            model.applyDelta(delta);
+        }
+    }
+}
+
+void TestCore::sharedColumnsMatchText()
+{
+    if (!SharedColumns::isSupported()) {
+        QSKIP("No POSIX shared memory on this platform");
+    }
+
+    Column numbers = makeColumn(true, 5);
+    numbers.numbers[3] = std::nan("");
+    const auto shared = shareSegment(encodeSegment(numbers, {2}));
+    QVERIFY(shared);
+    QCOMPARE(shared->rowCount(), 5);
+    QCOMPARE(shared->columnCount(), 1);
+    const QStringList expected{"0", "1.25", "NA", "NaN", "5"};
+    for (int row = 0; row < 5; ++row) {
+        QCOMPARE(shared->cell(row, 0), expected.at(row));
+    }
+
+    // Doubles print as R prints them, not as printf's %g
+    Column doubles;
+    doubles.numbers = {12345678, 1e5, 123456, 1e-4, 0.001, 1.0 / 3, -1.5, 1e15,
+                       123456789012, 9.9999999, 2.5e-7, -0.00012345};
+    const QStringList printed{"12345678", "1e+05", "123456", "1e-04", "0.001", "0.3333333", "-1.5",
+                              "1e+15", "123456789012", "10", "2.5e-07", "-0.00012345"};
+    const auto sharedDoubles = shareSegment(encodeSegment(doubles));
+    QVERIFY(sharedDoubles);
+    for (int row = 0; row < printed.size(); ++row) {
+        QCOMPARE(sharedDoubles->cell(row, 0), printed.at(row));
+    }
+
+    Column strings;
+    strings.numeric = false;
+    strings.strings = QStringList{"a", "", QString::fromUtf8("\u00e9t\u00e9"), "NA?"};
+    const auto sharedStrings = shareSegment(encodeSegment(strings, {3}));
+    QVERIFY(sharedStrings);
+    QCOMPARE(sharedStrings->cell(0, 0), QString("a"));
+    QCOMPARE(sharedStrings->cell(1, 0), QString());
+    QCOMPARE(sharedStrings->cell(2, 0), QString::fromUtf8("\u00e9t\u00e9"));
+    QCOMPARE(sharedStrings->cell(3, 0), QString("NA"));
+
+    // The text path must show the same cells
+    DataTablePage page;
+    QVERIFY(SessionChannel::decodeTablePage(encodeTextRows(strings), page));
+    QCOMPARE(page.rowCount, 4);
+    QCOMPARE(page.cell(2, 0), QString::fromUtf8("\u00e9t\u00e9"));
+}
+
+void TestCore::benchmarkPageTransfer_data()
+{
+    QTest::addColumn<bool>("numeric");
+    QTest::addColumn<QString>("transport");
+
+    for (bool numeric : {true, false}) {
+        const char *type = numeric ? "numeric" : "character";
+        for (const char *transport : {"json", "text", "shared"}) {
+            QTest::addRow("1M %s rows, %s", type, transport) << numeric << QString(transport);
+        }
+    }
+}
+
+void TestCore::benchmarkPageTransfer()
+{
+    QFETCH(bool, numeric);
+    QFETCH(QString, transport);
+    if (transport == "shared" && !SharedColumns::isSupported()) {
+        QSKIP("No POSIX shared memory on this platform");
+    }
+
+    // Q's side of the transfer: decoding and producing every cell's text.
+    // The shared case also copies the image into a fresh segment, as R
+    // does, since mapping unlinks it.
+    const Column column = makeColumn(numeric, 1000000);
+    const QByteArray json = encodeJson(column);
+    const QByteArray text = encodeTextRows(column);
+    const QByteArray image = encodeSegment(column);
+    qsizetype characters = 0;
+
+    QBENCHMARK {
+        characters = 0;
+        if (transport == "json") {
+            const QJsonArray array = QJsonDocument::fromJson(json).array();
+            for (const QJsonValue &value : array) {
+                characters += (numeric ? QString::number(value.toDouble(), 'g', 7) : value.toString()).size();
+            }
+        } else if (transport == "text") {
+            DataTablePage page;
+            SessionChannel::decodeTablePage(text, page);
+            for (int row = 0; row < page.rowCount; ++row) {
+                characters += page.cell(row, 0).size();
+            }
+        } else {
+            const auto shared = shareSegment(image);
+            QVERIFY(shared);
+            for (int row = 0; row < shared->rowCount(); ++row) {
+                characters += shared->cell(row, 0).size();
+            }
+        }
+    }
+    QVERIFY(characters > 0);
+}
+
+void TestCore::truncatedUtf8AtEndIsShown()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("truncated.R");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    // "é" whole, then the first byte of "€" and nothing after it
+    file.write("x <- \"\xc3\xa9\xe2\x82");
+    file.close();
+
+    FileReader reader(path);
+    QString text;
+    connect(&reader, &FileReader::chunkRead, this, [&reader, &text](const QString &chunk) {
+        text += chunk;
+        reader.readChunk();
+    });
+    QSignalSpy invalid(&reader, &FileReader::invalidText);
+    QSignalSpy finished(&reader, &FileReader::finished);
+    reader.open();
+
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(invalid.count(), 1);
+    QCOMPARE(text, QString::fromUtf8("x <- \"\xc3\xa9\xe2\x82"));
+    QVERIFY(text.endsWith(QChar::ReplacementCharacter));
+}
+
+void TestCore::sessionIdleNeedsConfirmedPing()
+{
+    SessionChannel channel;
+    QVERIFY(!channel.address().isEmpty());
+    FakeR r;
+    r.socket.connectToServer(channel.address());
+    QVERIFY(r.socket.waitForConnected(1000));
+    QTRY_VERIFY(channel.isConnected());
+
+    SessionState state(&channel);
+    QSignalSpy idle(&state, &SessionState::idle);
+    state.inputSent();
+    QVERIFY(state.isBusy());
+
+    // A busy R does not answer, so the ping is repeated
+    QTRY_VERIFY(r.poll() >= 2);
+    QVERIFY(state.isBusy());
+    QVERIFY(r.pings.at(1) > r.pings.at(0));
+
+    // One answer only asks for a confirming ping
+    const quint32 answered = r.pings.last();
+    r.answer(answered);
+    QTRY_VERIFY(r.poll() > 0 && r.pings.last() > answered);
+    QVERIFY(state.isBusy());
+    QCOMPARE(idle.count(), 0);
+
+    r.answer(r.pings.last());
+    QTRY_COMPARE(idle.count(), 1);
+    QVERIFY(!state.isBusy());
+
+    // Answers to pings sent before the latest input do not count
+    state.inputSent();
+    QVERIFY(state.isBusy());
+    r.answer(r.pings.last());
+    QTest::qWait(50);
+    QVERIFY(state.isBusy());
+
+    // Losing R ends the busy period
+    r.socket.disconnectFromServer();
+    QTRY_VERIFY(!state.isBusy());
+    QCOMPARE(idle.count(), 2);
+}
+
+QTEST_MAIN(TestCore)
+#include "tst_core.moc"
@@ -0,0 +1,249 @@
+#include <QtTest>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include "rsyntaxhighlighter.h"
+#include <memory>
+
+namespace {
+
+constexpr int DocumentLines = 50000;
+// An edit that leaves the block's end state alone re-highlights that
+// block only; a little slack keeps the test about the order of growth
+constexpr int MaxRehighlightedBlocks = 3;
+// Lines 10 to 12 hold a string spanning three lines
+constexpr int StringFirstLine = 10;
+
+// Counts the blocks QSyntaxHighlighter hands to highlightBlock()
+class CountingHighlighter : public RSyntaxHighlighter
+{
+public:
+    using RSyntaxHighlighter::RSyntaxHighlighter;
+
+    int blocks = 0;
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        ++blocks;
+        RSyntaxHighlighter::highlightBlock(text);
+    }
+};
+
+// The highlighter the single-pass lexer replaced: one regular expression
+// per keyword, operator and token class, each run over every line. Kept
+// only as the baseline for benchmarkHighlightDocument.
+class RegexHighlighter : public QSyntaxHighlighter
+{
+public:
+    RegexHighlighter(QTextDocument *document, const EditorTheme &theme)
+        : QSyntaxHighlighter(document)
+    {
+        QTextCharFormat keyword;
+        keyword.setForeground(theme.keyword);
+        keyword.setFontWeight(QFont::Bold);
+        for (const char *word : {"if", "else", "for", "while", "repeat", "function", "return", "next", "break",
+                                 "TRUE", "FALSE", "NULL", "NA", "NaN", "Inf", "in"}) {
+            rules.append({QRegularExpression(QString("\\b%1\\b").arg(word)), keyword});
+        }
+
+        QTextCharFormat function;
+        function.setForeground(theme.function);
+        rules.append({QRegularExpression("\\b[A-Za-z0-9_\\.]+(?=\\s*\\()"), function});
+
+        QTextCharFormat number;
+        number.setForeground(theme.number);
+        rules.append({QRegularExpression("\\b[0-9]+\\.?[0-9]*([eE][-+]?[0-9]+)?\\b"), number});
+
+        QTextCharFormat op;
+        op.setForeground(theme.operator_);
+        for (const char *pattern : {"\\+", "-", "\\*", "/", "\\^", "%%", "%/%", "==", "!=", "<", ">", "<=", ">=",
+                                    "\\&", "\\|", "!", "&&", "\\|\\|", "<-", "<<-", "->", "->>", "=", "~"}) {
+            rules.append({QRegularExpression(pattern), op});
+        }
+
+        QTextCharFormat string;
+        string.setForeground(theme.string);
+        rules.append({QRegularExpression("\"[^\"\\\\]*(\\\\.[^\"\\\\]*)*\""), string});
+        rules.append({QRegularExpression("'[^'\\\\]*(\\\\.[^'\\\\]*)*'"), string});
+
+        QTextCharFormat comment;
+        comment.setForeground(theme.comment);
+        comment.setFontItalic(true);
+        rules.append({QRegularExpression("#[^\n]*"), comment});
+    }
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        for (const Rule &rule : std::as_const(rules)) {
+            QRegularExpressionMatchIterator matches = rule.pattern.globalMatch(text);
+            while (matches.hasNext()) {
+                const QRegularExpressionMatch match = matches.next();
+                setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            }
+        }
+    }
+
+private:
+    struct Rule {
+        QRegularExpression pattern;
+        QTextCharFormat format;
+    };
+    QVector<Rule> rules;
+};
+
+// An R script mixing code, comments, strings and numbers
+QString script(int lines)
+{
+    QStringList out;
+    out.reserve(lines);
+    for (int i = 0; i < lines; ++i) {
+        if (i == StringFirstLine) {
+            out << "msg <- \"a string that";
+        } else if (i == StringFirstLine + 1) {
+            out << "goes on # not a comment";
+        } else if (i == StringFirstLine + 2) {
+            out << "and ends here\"";
+        } else {
+            switch (i % 4) {
+            case 0: out << QString("x%1 <- c(1L, 0x1F, 2.5e3, 3i)").arg(i); break;
+            case 1: out << "if (x > 0) y <- x |> sqrt() else y <- NA"; break;
+            case 2: out << "# a comment with \"quotes\" and if"; break;
+            default: out << "cat('value:', x %in% y, \"\\n\")"; break;
+            }
+        }
+    }
+    return out.join('\n');
+}
+
+int lexerState(const QTextBlock &block)
+{
+    return qMax(0, block.userState()) & RLexer::StateKindMask;
+}
+
+} // namespace
+
+class TestRSyntaxHighlighter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void highlightsWholeDocumentOnce();
+    void editOnFirstLineIsBounded();
+    void editInsideMultiLineStringIsBounded();
+    void benchmarkEditFirstLine();
+    void benchmarkHighlightDocument_data();
+    void benchmarkHighlightDocument();
+
+private:
+    QTemporaryDir settingsDir;
+    QTextDocument *document = nullptr;
+    CountingHighlighter *highlighter = nullptr;
+};
+
+void TestRSyntaxHighlighter::initTestCase()
+{
+    // Keep the user's settings and themes out of the test, and lex
+    // synchronously so every highlighted block is counted
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(settingsDir.isValid());
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, settingsDir.path());
+    QSettings("Q", "Q").setValue("editor/backgroundHighlightLines", 0);
+}
+
+void TestRSyntaxHighlighter::init()
+{
+    document = new QTextDocument;
+    document->setPlainText(script(DocumentLines));
+    highlighter = new CountingHighlighter(document);
+    // setDocument() schedules the first full pass on the event loop
+    QTRY_COMPARE(highlighter->blocks, DocumentLines);
+    highlighter->blocks = 0;
+}
+
+void TestRSyntaxHighlighter::cleanup()
+{
+    delete highlighter;
+    highlighter = nullptr;
+    delete document;
+    document = nullptr;
+}
+
+void TestRSyntaxHighlighter::highlightsWholeDocumentOnce()
+{
+    QCOMPARE(document->blockCount(), DocumentLines);
+    QCOMPARE(lexerState(document->findBlockByNumber(StringFirstLine)), int(RLexer::InDoubleString));
+    QCOMPARE(lexerState(document->findBlockByNumber(StringFirstLine + 1)), int(RLexer::InDoubleString));
+    QCOMPARE(lexerState(document->findBlockByNumber(StringFirstLine + 2)), int(RLexer::Normal));
+
+    // Nothing else is pending
+    QCoreApplication::processEvents();
+    QCOMPARE(highlighter->blocks, 0);
+}
+
+void TestRSyntaxHighlighter::editOnFirstLineIsBounded()
+{
+    QTextCursor cursor(document->firstBlock());
+    cursor.insertText("y <- 2; ");
+
+    QVERIFY(highlighter->blocks >= 1);
+    QVERIFY2(highlighter->blocks <= MaxRehighlightedBlocks,
+             qPrintable(QString("%1 blocks re-highlighted").arg(highlighter->blocks)));
+}
+
+void TestRSyntaxHighlighter::editInsideMultiLineStringIsBounded()
+{
+    QTextCursor cursor(document->findBlockByNumber(StringFirstLine + 1));
+    cursor.insertText("# still a string ");
+
+    QVERIFY2(highlighter->blocks <= MaxRehighlightedBlocks,
+             qPrintable(QString("%1 blocks re-highlighted").arg(highlighter->blocks)));
+    QCOMPARE(lexerState(document->findBlockByNumber(StringFirstLine + 1)), int(RLexer::InDoubleString));
+    QCOMPARE(lexerState(document->findBlockByNumber(StringFirstLine + 2)), int(RLexer::Normal));
+}
+
+void TestRSyntaxHighlighter::benchmarkEditFirstLine()
+{
+    QTextCursor cursor(document->firstBlock());
+    QBENCHMARK {
+        cursor.insertText("z");
+        cursor.deletePreviousChar();
+    }
+}
+
+void TestRSyntaxHighlighter::benchmarkHighlightDocument_data()
+{
+    QTest::addColumn<bool>("lexer");
+    QTest::newRow("before: regex per rule") << false;
+    QTest::newRow("after: single-pass lexer") << true;
+}
+
+void TestRSyntaxHighlighter::benchmarkHighlightDocument()
+{
+    QFETCH(bool, lexer);
+
+    // Highlighting the whole script from scratch, as on opening a file
+    QTextDocument script10k;
+    script10k.setPlainText(script(10000));
+    std::unique_ptr<QSyntaxHighlighter> highlighter;
+    if (lexer) {
+        highlighter = std::make_unique<RSyntaxHighlighter>(&script10k);
+    } else {
+        highlighter = std::make_unique<RegexHighlighter>(&script10k, ThemeManager::instance().currentTheme());
+    }
+    QBENCHMARK {
+        highlighter->rehighlight();
+    }
+}
+
+QTEST_MAIN(TestRSyntaxHighlighter)
+#include "tst_rsyntaxhighlighter.moc"